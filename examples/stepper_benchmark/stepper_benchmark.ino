@@ -0,0 +1,117 @@
+/*
+ Stepper Motor Control - benchmark
+
+ This program measures how fast the library can step a motor on the
+ board it runs on, and how evenly the steps are spaced, then prints
+ a table to the serial monitor.
+
+ No motor needs to be connected: the library drives digital pins 8 - 12
+ in turn as a 2 wire, 4 wire and 5 wire motor, and as a step and
+ direction driver.  For each of them it prints
+
+ - the top rate, in steps per second, of step() with no delay between
+   steps, and the time and CPU cycles each step takes at that rate;
+ - the shortest, longest and average time between the steps of run()
+   at 1000 steps per second, and the jitter, the difference between
+   the longest and the shortest.
+
+ Run it before and after a change to the library to see what the
+ change costs or saves.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+
+const int stepsPerRevolution = 200;  // makes no difference to the results
+
+const long rateSteps = 4000;         // steps taken to measure the top rate
+const long jitterSteps = 1000;       // steps taken to measure the jitter
+const unsigned long jitterInterval = 1000;  // delay between those steps, in us
+
+// one motor of each kind, all on the same pins:
+Stepper twoWire(stepsPerRevolution, 8, 9);
+Stepper fourWire(stepsPerRevolution, 8, 9, 10, 11);
+Stepper fiveWire(stepsPerRevolution, 8, 9, 10, 11, 12);
+Stepper driver(stepsPerRevolution, STEPPER_DRIVER, 8, 9);
+
+// the CPU clock, in MHz, to turn times into cycles:
+unsigned long cpuMHz() {
+#if defined(F_CPU)
+  return F_CPU / 1000000UL;
+#else
+  return SystemCoreClock / 1000000UL;
+#endif
+}
+
+void benchmark(const char *name, Stepper &motor) {
+  // top rate: as many steps as possible, no delay in between:
+  motor.setStepInterval(0);
+  unsigned long start = micros();
+  motor.step(rateSteps);
+  unsigned long elapsed = micros() - start;
+
+  // jitter: the time between the steps of run(), at a fixed rate:
+  unsigned long shortest = 0xFFFFFFFFUL;
+  unsigned long longest = 0;
+  unsigned long total = 0;
+  long intervals = 0;
+  unsigned long lastStep = 0;
+  long position = motor.currentPosition();
+
+  motor.setStepInterval(jitterInterval);
+  motor.move(jitterSteps);
+  while (motor.run()) {
+    if (motor.currentPosition() == position) {
+      continue;
+    }
+    unsigned long now = micros();
+    if (lastStep != 0) {
+      unsigned long interval = now - lastStep;
+      shortest = min(shortest, interval);
+      longest = max(longest, interval);
+      total += interval;
+      intervals++;
+    }
+    lastStep = now;
+    position = motor.currentPosition();
+  }
+  motor.release();
+
+  Serial.print(name);
+  Serial.print('\t');
+  Serial.print(rateSteps * 1000000.0 / elapsed, 0);
+  Serial.print('\t');
+  Serial.print((float)elapsed / rateSteps, 2);
+  Serial.print('\t');
+  Serial.print(elapsed * cpuMHz() / rateSteps);
+  Serial.print('\t');
+  Serial.print(shortest);
+  Serial.print('\t');
+  Serial.print(longest);
+  Serial.print('\t');
+  Serial.print((float)total / intervals, 1);
+  Serial.print('\t');
+  Serial.println(longest - shortest);
+}
+
+void setup() {
+  // initialize the serial port, and wait for it on boards with native USB:
+  Serial.begin(9600);
+  while (!Serial);
+
+  Serial.print("CPU clock: ");
+  Serial.print(cpuMHz());
+  Serial.println(" MHz");
+  Serial.println("wiring\tsteps/s\tus/step\tcycles\tmin us\tmax us\tavg us\tjitter us");
+
+  benchmark("2 wire", twoWire);
+  benchmark("4 wire", fourWire);
+  benchmark("5 wire", fiveWire);
+  benchmark("driver", driver);
+}
+
+void loop() {
+  // nothing left to do
+}
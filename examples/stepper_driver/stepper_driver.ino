@@ -0,0 +1,37 @@
+/*
+ Stepper Motor Control - step and direction driver
+
+ This program drives a bipolar stepper motor through a step and
+ direction driver, such as an A4988, DRV8825 or TMC driver.
+ The STEP input of the driver is attached to digital pin 3 of the
+ Arduino, and the DIR input to digital pin 4.
+
+ The motor accelerates to a fast speed, turns five revolutions in one
+ direction, slows down to a stop, then does the same in the other
+ direction.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+
+// change this to the number of steps per revolution of your motor,
+// times the microsteps the driver is set to, e.g. 200 * 16:
+const int stepsPerRevolution = 3200;
+
+// initialize the Stepper library for a driver on pins 3 and 4:
+Stepper myStepper(stepsPerRevolution, STEPPER_DRIVER, 3, 4);
+
+void setup() {
+  // up to 5 revolutions per second, reached in half a second:
+  myStepper.setMaxSpeed(5L * stepsPerRevolution);
+  myStepper.setAcceleration(10L * stepsPerRevolution);
+}
+
+void loop() {
+  myStepper.step(5L * stepsPerRevolution);
+  delay(500);
+  myStepper.step(-5L * stepsPerRevolution);
+  delay(500);
+}
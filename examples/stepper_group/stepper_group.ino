@@ -0,0 +1,53 @@
+/*
+ Stepper Motor Control - coordinated group
+
+ This program drives two unipolar or bipolar stepper motors,
+ e.g. the X and Y axes of a plotter.
+ The motors are attached to digital pins 4 - 7 and 8 - 11 of the Arduino.
+
+ The motors move together along the corners of a triangle. On each
+ side, both motors start and stop at the same time, so the pen goes
+ in a straight line, even when one axis has further to go than the other.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperGroup.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the Stepper library on pins 4 through 7 and 8 through 11:
+Stepper xStepper(stepsPerRevolution, 4, 5, 6, 7);
+Stepper yStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+StepperGroup plotter;
+
+// corners of the triangle, in steps:
+const long corners[][2] = {
+  { 400, 0 },
+  { 200, 300 },
+  { 0, 0 }
+};
+
+int corner = 0;  // the corner to go to next
+
+void setup() {
+  // the axis with the longest move sets the pace, so set both speeds:
+  xStepper.setSpeed(60);
+  yStepper.setSpeed(60);
+
+  plotter.addStepper(xStepper);
+  plotter.addStepper(yStepper);
+}
+
+void loop() {
+  // go to the next corner and wait until both motors are there:
+  plotter.moveTo(corners[corner]);
+  plotter.runToPosition();
+  delay(500);
+
+  corner = (corner + 1) % 3;
+}
@@ -0,0 +1,56 @@
+/*
+ Stepper Motor Control - homing
+
+ This program drives a unipolar or bipolar stepper motor.
+ The motor is attached to digital pins 8 - 11 of the Arduino.
+ A limit switch is attached from digital pin 2 to ground, at the
+ reverse end of the motor's travel.
+
+ At start up, the motor finds its home: it runs quickly to the switch,
+ backs off slowly and comes back slowly, and calls where the switch
+ closes position 0. Then it goes back and forth from 100 to 2000 steps
+ from home. Should it ever reach the switch, the switch stops it at
+ once, from the pin's interrupt.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperLimitSwitch.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the Stepper library on pins 8 through 11:
+Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+// the switch on pin 2 reads LOW when pressed:
+StepperLimitSwitch homeSwitch(myStepper, 2, LOW);
+
+void setup() {
+  Serial.begin(9600);
+  myStepper.setMaxSpeed(500);
+  myStepper.setAcceleration(2000);
+  homeSwitch.begin();
+
+  // look for the switch up to 10 revolutions back, at 1000 then 50 steps per second:
+  if (homeSwitch.homing(-10 * stepsPerRevolution, 1000, 50)) {
+    Serial.println("home found");
+  } else {
+    Serial.println("no switch found");
+  }
+  homeSwitch.clear();
+}
+
+void loop() {
+  if (homeSwitch.triggered()) {
+    Serial.print("limit switch hit at ");
+    Serial.println(homeSwitch.triggerPosition());
+    homeSwitch.clear();
+  }
+
+  if (!myStepper.run()) {
+    myStepper.moveTo(myStepper.currentPosition() < 1000 ? 2000 : 100);
+  }
+}
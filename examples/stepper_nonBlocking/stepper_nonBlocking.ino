@@ -0,0 +1,45 @@
+/*
+ Stepper Motor Control - non-blocking
+
+ This program drives a unipolar or bipolar stepper motor.
+ The motor is attached to digital pins 8 - 11 of the Arduino.
+
+ The motor turns one revolution in one direction, then one revolution
+ in the other direction, like the one revolution example. Because the
+ move is carried out by run() instead of step(), loop() keeps running
+ while the motor turns, and the built-in LED blinks at the same time.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the Stepper library on pins 8 through 11:
+Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+int direction = 1;                  // direction of the next revolution
+unsigned long lastBlink = 0;        // time of the last LED toggle, in ms
+
+void setup() {
+  // set the speed at 60 rpm:
+  myStepper.setSpeed(60);
+  pinMode(LED_BUILTIN, OUTPUT);
+}
+
+void loop() {
+  // take a step if one is due; once the revolution is done, turn back:
+  if (!myStepper.run()) {
+    myStepper.move(direction * stepsPerRevolution);
+    direction = -direction;
+  }
+
+  // meanwhile, do other work:
+  if (millis() - lastBlink >= 250) {
+    lastBlink = millis();
+    digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+  }
+}
@@ -0,0 +1,47 @@
+/*
+ Stepper Motor Control - precomputed move
+
+ This program drives a unipolar or bipolar stepper motor.
+ The motor is attached to digital pins 8 - 11 of the Arduino.
+
+ The motor goes back and forth over the same 3000 steps, ramping up
+ and down, as a pick and place machine does. The ramp is worked out
+ only once, in setup(), and each move plays it again, so each takes
+ just as long as the one before; the serial monitor shows how long.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperProfile.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the Stepper library on pins 8 through 11:
+Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+// room for the ramp up and down, one entry per step of speeding up:
+int16_t ramp[300];
+StepperProfile pick(ramp, 300);
+
+void setup() {
+  Serial.begin(9600);
+  // 2000 steps per second, ramped up and down at 8000 steps per second per second:
+  myStepper.setMaxSpeed(2000);
+  myStepper.setAcceleration(8000);
+  if (!pick.compile(myStepper, 3000)) {
+    Serial.println("the ramp doesn't fit");
+  }
+}
+
+void loop() {
+  unsigned long start = millis();
+  pick.play(myStepper);
+  pick.runToPosition();
+  pick.playReverse(myStepper);
+  pick.runToPosition();
+  Serial.print("cycle time in ms: ");
+  Serial.println(millis() - start);
+}
@@ -0,0 +1,60 @@
+/*
+ Stepper Motor Control - queued moves
+
+ This program drives a unipolar or bipolar stepper motor.
+ The motor is attached to digital pins 8 - 11 of the Arduino.
+
+ Moves are read from the serial port, one per line, as the number of
+ steps and the speed in steps per second, e.g. "200 600" or "-50 300".
+ They are queued and run back to back: where two moves go the same
+ way, the motor carries on at speed from one to the next instead of
+ stopping in between.  Send the moves faster than they run, and the
+ queue fills up; a move that doesn't fit is reported and dropped.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperQueue.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the stepper library on pins 8 through 11:
+Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+StepperQueue moves(myStepper);
+
+char line[24];    // the move being read from the serial port
+int lineLength = 0;
+
+void setup() {
+  // ramp the speed up and down by 2000 steps per second, every second:
+  myStepper.setAcceleration(2000);
+  // initialize the serial port:
+  Serial.begin(9600);
+}
+
+void loop() {
+  // read the serial port a character at a time, so the motor keeps going:
+  if (Serial.available() > 0) {
+    char c = Serial.read();
+    if (c == '\n' || c == '\r') {
+      line[lineLength] = '\0';
+      lineLength = 0;
+      // queue the move:
+      char *end;
+      long steps = strtol(line, &end, 10);
+      long speed = strtol(end, NULL, 10);
+      if (speed > 0 && !moves.push(steps, speed)) {
+        Serial.println("queue full");
+      }
+    } else if (lineLength < (int)sizeof(line) - 1) {
+      line[lineLength++] = c;
+    }
+  }
+
+  // take a step, if one is due:
+  moves.run();
+}
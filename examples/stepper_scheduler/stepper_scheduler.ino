@@ -0,0 +1,75 @@
+/*
+ Stepper Motor Control - scheduler
+
+ This program drives three unipolar or bipolar stepper motors, each on
+ its own, at different speeds.
+ The motors are attached to digital pins 2 - 5, 6 - 9 and 10 - 13 of the Arduino.
+
+ The scheduler keeps track of which motor is due to step next, so loop()
+ doesn't have to poll every motor. While no step is due, the sketch is
+ free to do other work: here it counts how often it gets the chance, and
+ prints that once a second.
+
+ Each motor goes back and forth over its own distance, starting a new
+ move as soon as it has finished the last one.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperScheduler.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motors
+
+// initialize the Stepper library on pins 2 through 13:
+Stepper conveyor(stepsPerRevolution, 2, 3, 4, 5);
+Stepper sorter(stepsPerRevolution, 6, 7, 8, 9);
+Stepper gate(stepsPerRevolution, 10, 11, 12, 13);
+
+StepperScheduler scheduler;
+
+unsigned long idleChances = 0;    // times there was time for other work
+unsigned long lastReport = 0;     // time of the last report, in ms
+
+void setup() {
+  conveyor.setMaxSpeed(400);
+  sorter.setMaxSpeed(250);
+  gate.setMaxSpeed(100);
+
+  scheduler.addStepper(conveyor);
+  scheduler.addStepper(sorter);
+  scheduler.addStepper(gate);
+
+  Serial.begin(9600);
+}
+
+void loop() {
+  // start a new move on each motor that has finished its last one:
+  if (conveyor.distanceToGo() == 0) {
+    conveyor.move(stepsPerRevolution);
+  }
+  if (sorter.distanceToGo() == 0) {
+    sorter.moveTo(sorter.currentPosition() > 0 ? 0 : 300);
+  }
+  if (gate.distanceToGo() == 0) {
+    gate.moveTo(gate.currentPosition() > 0 ? 0 : 50);
+  }
+
+  // step the motors that are due:
+  scheduler.run();
+
+  // with more than 100 us to go before the next step, do other work:
+  if (scheduler.timeToNextStep() > 100) {
+    idleChances++;
+  }
+
+  if (millis() - lastReport >= 1000) {
+    lastReport = millis();
+    Serial.print("time for other work ");
+    Serial.print(idleChances);
+    Serial.println(" times in the last second");
+    idleChances = 0;
+  }
+}
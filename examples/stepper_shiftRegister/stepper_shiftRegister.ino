@@ -0,0 +1,58 @@
+/*
+ Stepper Motor Control - shift register outputs
+
+ This program drives four unipolar or bipolar stepper motors.
+ The motors are attached, through their driver boards, to the outputs
+ of two 74HC595 shift registers, four outputs each: Q0 - Q3 and
+ Q4 - Q7 of the first register, and Q0 - Q3 and Q4 - Q7 of the second.
+ The first register's SER input is on the Arduino's SPI MOSI pin, its
+ QH' output goes to the second's SER, and both registers' SRCLK and
+ RCLK inputs are on the SPI SCK pin and digital pin 10.
+
+ Each motor turns back and forth, at its own speed, and all four
+ patterns go out in one SPI transfer whenever any of them changes.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperShiftRegister.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// two 74HC595s, latched by pin 10:
+StepperShiftRegister outputs(STEPPER_74HC595, 10, 2);
+
+// initialize the Stepper library on outputs 0 through 15:
+Stepper motors[4] = {
+  Stepper(stepsPerRevolution, STEPPER_SHIFT_PIN(0), STEPPER_SHIFT_PIN(1),
+                              STEPPER_SHIFT_PIN(2), STEPPER_SHIFT_PIN(3)),
+  Stepper(stepsPerRevolution, STEPPER_SHIFT_PIN(4), STEPPER_SHIFT_PIN(5),
+                              STEPPER_SHIFT_PIN(6), STEPPER_SHIFT_PIN(7)),
+  Stepper(stepsPerRevolution, STEPPER_SHIFT_PIN(8), STEPPER_SHIFT_PIN(9),
+                              STEPPER_SHIFT_PIN(10), STEPPER_SHIFT_PIN(11)),
+  Stepper(stepsPerRevolution, STEPPER_SHIFT_PIN(12), STEPPER_SHIFT_PIN(13),
+                              STEPPER_SHIFT_PIN(14), STEPPER_SHIFT_PIN(15))
+};
+
+void setup() {
+  for (int i = 0; i < 4; i++) {
+    // 100, 200, 300 and 400 steps per second:
+    motors[i].setMaxSpeed(100 * (i + 1));
+    motors[i].setAcceleration(400);
+    outputs.addStepper(motors[i]);
+  }
+  outputs.begin();
+}
+
+void loop() {
+  // turn each motor back the other way once it gets there:
+  for (int i = 0; i < 4; i++) {
+    if (motors[i].distanceToGo() == 0) {
+      motors[i].moveTo(motors[i].currentPosition() == 0 ? stepsPerRevolution : 0);
+    }
+  }
+  outputs.run();
+}
@@ -6,9 +6,10 @@
  A potentiometer is connected to analog input 0.
 
  The motor will rotate in a clockwise direction. The higher the potentiometer value,
- the faster the motor speed. Because setSpeed() sets the delay between steps,
- you may notice the motor is less responsive to changes in the sensor value at
- low speeds.
+ the faster the motor speed. The motor ramps smoothly to each new speed, within
+ the acceleration set, so the knob can take it to speeds it couldn't start at.
+ The knob is read every 20 milliseconds; in between, loop() does nothing but
+ step the motor, so it keeps up with high speeds.
 
  Created 30 Nov. 2009
  Modified 28 Oct 2010
@@ -21,25 +22,32 @@
 const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
 // for your motor
 
+const long maxSpeed = 2000;     // top speed, in steps per second
+const long acceleration = 4000; // in steps per second per second
 
 // initialize the Stepper library on pins 8 through 11:
 Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
 
-int stepCount = 0;  // number of steps the motor has taken
+unsigned long lastReading = 0;  // time the sensor was last read, in ms
+int motorSpeed = 0;             // speed the motor is following, in steps per second
 
 void setup() {
-  // nothing to do inside the setup
+  myStepper.setAcceleration(acceleration);
 }
 
 void loop() {
-  // read the sensor value:
-  int sensorReading = analogRead(A0);
-  // map it to a range from 0 to 100:
-  int motorSpeed = map(sensorReading, 0, 1023, 0, 100);
-  // set the motor speed:
-  if (motorSpeed > 0) {
-    myStepper.setSpeed(motorSpeed);
-    // step 1/100 of a revolution:
-    myStepper.step(stepsPerRevolution / 100);
+  if (millis() - lastReading >= 20) {
+    lastReading = millis();
+    // read the sensor value:
+    int sensorReading = analogRead(A0);
+    // map it to a range from 0 to the top speed:
+    int newSpeed = map(sensorReading, 0, 1023, 0, maxSpeed);
+    // set the motor speed, only when it changes:
+    if (newSpeed != motorSpeed) {
+      motorSpeed = newSpeed;
+      myStepper.setSpeedStepsPerSecond(motorSpeed);
+    }
   }
+  // take a step when it's due, ramping towards the speed set:
+  myStepper.runSpeed();
 }
@@ -0,0 +1,59 @@
+/*
+ Stepper Motor Control - motion thread
+
+ This program drives a unipolar or bipolar stepper motor.
+ The motor is attached to digital pins 8 - 11 of the Arduino.
+
+ The motor turns one revolution in one direction, then one revolution
+ in the other direction. On Mbed OS boards (Portenta, Nano 33 BLE,
+ Nano RP2040 Connect), the steps are taken by a thread of their own,
+ so loop() can block, e.g. in delay(), without upsetting the motor.
+ On other boards the motor is driven from loop() with run() instead.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperThread.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the Stepper library on pins 8 through 11:
+Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+#ifdef STEPPER_THREAD_SUPPORTED
+// the thread that will drive the motor:
+StepperThread motion(myStepper);
+#endif
+
+int direction = 1;  // direction of the next revolution
+
+void setup() {
+  // 300 steps per second, ramped up and down at 1000 steps per second per second:
+  myStepper.setMaxSpeed(300);
+  myStepper.setAcceleration(1000);
+  Serial.begin(9600);
+#ifdef STEPPER_THREAD_SUPPORTED
+  // from now on the motion thread takes the steps:
+  motion.begin();
+#endif
+}
+
+void loop() {
+#ifdef STEPPER_THREAD_SUPPORTED
+  if (!motion.isRunning()) {
+    motion.move(direction * stepsPerRevolution);
+    direction = -direction;
+  }
+  // loop() can block without stopping the motor:
+  Serial.println(motion.currentPosition());
+  delay(100);
+#else
+  if (!myStepper.run()) {
+    myStepper.move(direction * stepsPerRevolution);
+    direction = -direction;
+  }
+#endif
+}
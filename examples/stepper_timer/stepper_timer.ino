@@ -0,0 +1,53 @@
+/*
+ Stepper Motor Control - timer interrupt
+
+ This program drives a unipolar or bipolar stepper motor.
+ The motor is attached to digital pins 8 - 11 of the Arduino.
+
+ The motor turns one revolution in one direction, then one revolution
+ in the other direction. The steps are taken by a hardware timer
+ interrupt, so the step timing stays steady however busy loop() is.
+ On boards without timer support the motor is driven from loop()
+ with run() instead.
+
+ This example code is in the public domain.
+
+ */
+
+#include <Stepper.h>
+#include <StepperTimer.h>
+
+const int stepsPerRevolution = 200;  // change this to fit the number of steps per revolution
+// for your motor
+
+// initialize the Stepper library on pins 8 through 11:
+Stepper myStepper(stepsPerRevolution, 8, 9, 10, 11);
+
+int direction = 1;  // direction of the next revolution
+
+void setup() {
+  // set the speed at 60 rpm:
+  myStepper.setSpeed(60);
+  Serial.begin(9600);
+#ifdef STEPPER_TIMER_SUPPORTED
+  // from now on the timer interrupt takes the steps:
+  StepperTimer::begin(myStepper);
+#endif
+}
+
+void loop() {
+#ifdef STEPPER_TIMER_SUPPORTED
+  if (!StepperTimer::isRunning()) {
+    StepperTimer::move(direction * stepsPerRevolution);
+    direction = -direction;
+  }
+  // loop() is free for other work, even slow work:
+  Serial.println("busy");
+  delay(100);
+#else
+  if (!myStepper.run()) {
+    myStepper.move(direction * stepsPerRevolution);
+    direction = -direction;
+  }
+#endif
+}
@@ -61,6 +61,27 @@
  *    3  0  1  0  1
  *    4  1  0  0  1
  *
+ * With 4 control wires, setStepMode() can also select half stepping,
+ * which adds a step with a single coil on between each of the above:
+ *
+ * Step C0 C1 C2 C3
+ *    1  1  0  1  0
+ *    2  0  0  1  0
+ *    3  0  1  1  0
+ *    4  0  1  0  0
+ *    5  0  1  0  1
+ *    6  0  0  0  1
+ *    7  1  0  0  1
+ *    8  1  0  0  0
+ *
+ * or wave drive, which only uses those single coil steps:
+ *
+ * Step C0 C1 C2 C3
+ *    1  0  0  1  0
+ *    2  0  1  0  0
+ *    3  0  0  0  1
+ *    4  1  0  0  0
+ *
  * The sequence of control signals for 2 control wires is as follows
  * (columns C1 and C2 from above):
  *
@@ -78,32 +99,134 @@
 #include "Arduino.h"
 #include "Stepper.h"
 
+#if defined(__AVR__)
+#include <avr/pgmspace.h>
+#define STEPPER_PROGMEM PROGMEM
+#define stepper_read_pattern(p) pgm_read_byte(p)
+#else
+#define STEPPER_PROGMEM
+#define stepper_read_pattern(p) (*(p))
+#endif
+
+// how often, in us, the core's clock tick interrupt is sure to wake the
+// CPU up from idle sleep, see setLowPowerIdle():
+#if defined(__AVR__)
+#include <avr/sleep.h>
+#define STEPPER_WAKE_INTERVAL (16384000UL / (F_CPU / 1000UL)) // Timer0 overflow
+#elif defined(ARDUINO_ARCH_SAMD)
+#define STEPPER_WAKE_INTERVAL 1000UL  // SysTick
+#elif defined(ARDUINO_ARCH_MBED)
+#include "mbed.h"
+#define STEPPER_WAKE_INTERVAL 1000UL  // the RTOS sleeps in whole ms
+#endif
+
+/*
+ * Coil sequences, one pattern per step, motor_pin_1 in the most
+ * significant bit (see the tables at the top of this file).
+ */
+static const uint8_t sequence_2wire[4] STEPPER_PROGMEM = {
+  0b01, 0b11, 0b10, 0b00
+};
+static const uint8_t sequence_4wire[4] STEPPER_PROGMEM = {
+  0b1010, 0b0110, 0b0101, 0b1001
+};
+static const uint8_t sequence_4wire_half[8] STEPPER_PROGMEM = {
+  0b1010, 0b0010, 0b0110, 0b0100, 0b0101, 0b0001, 0b1001, 0b1000
+};
+static const uint8_t sequence_4wire_wave[4] STEPPER_PROGMEM = {
+  0b0010, 0b0100, 0b0001, 0b1000
+};
+static const uint8_t sequence_5wire[10] STEPPER_PROGMEM = {
+  0b01101, 0b01001, 0b01011, 0b01010, 0b11010,
+  0b10010, 0b10110, 0b10100, 0b10101, 0b00101
+};
+
+/*
+ * First quarter of a sine wave, 255 * sin(i * 90 / 32 degrees), for the
+ * coil currents when microstepping, see setMicrostepping().
+ */
+static const uint8_t sine_quarter[33] STEPPER_PROGMEM = {
+    0,  13,  25,  37,  50,  62,  74,  86,  98, 109, 120,
+  131, 142, 152, 162, 171, 180, 189, 197, 205, 212, 219,
+  225, 231, 236, 240, 244, 247, 250, 252, 254, 255, 255
+};
+
+// limits keeping the acceleration ramp arithmetic within 32 bits:
+#define STEPPER_MAX_ACCELERATION  1000000L  // steps/s/s
+#define STEPPER_MAX_RAMP_INTERVAL 262143UL  // us, i.e. ~4 steps/s at the start
+
+/*
+ * Writes the pattern of a motor on shift register outputs.  It's set by
+ * StepperShiftRegister::addStepper(), so that sketches which don't use
+ * shift registers link neither that class nor the SPI library.
+ */
+void (*Stepper::shift_output)(Stepper *motor, uint8_t pattern) = 0;
+
+/*
+ * Makes a motor pin an output, unless it's a shift register bit.
+ */
+static void outputPin(uint8_t pin)
+{
+  if (pin < STEPPER_SHIFT_PIN(0))
+    pinMode(pin, OUTPUT);
+}
+
 /*
  * two-wire constructor.
  * Sets which wires should control the motor.
  */
 Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2)
 {
-  this->step_number = 0;    // which step the motor is on
+  this->step_number = 0;    // which step of the sequence the motor is on
   this->direction = 0;      // motor direction
   this->last_step_time = 0; // timestamp in us of the last step taken
   this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->current_position = 0; // position in steps since construction
+  this->target_position = 0;  // position run() is moving towards
+  this->ramp = 0;             // no acceleration ramp
+  this->step_delay = 0;       // no speed set yet
+#ifdef STEPPER_ENABLE_STATS
+  clearStats();
+#endif
+  this->released = false;     // coils on
+  this->fixed_rate = false;   // steps timed from when the last one was taken
+  this->low_power = false;    // busy wait between steps
+  this->step_fraction = 0;    // whole us step delay
+  this->fraction_sum = 0;     // no fractions of a us left over
+  this->microstep_stride = 0; // coils switched fully on or off
+  this->release_delay = 0;    // no auto-release
+  this->speed_direction = 0;  // runSpeed() stopped
+  this->halt_requested = false; // no stop asked for
+  this->shift_register = 0;   // pins on the board, or not yet added
 
   // Arduino pins for the motor control connection:
   this->motor_pin_1 = motor_pin_1;
   this->motor_pin_2 = motor_pin_2;
 
   // setup the pins on the microcontroller:
-  pinMode(this->motor_pin_1, OUTPUT);
-  pinMode(this->motor_pin_2, OUTPUT);
+  outputPin(this->motor_pin_1);
+  outputPin(this->motor_pin_2);
 
   // When there are only 2 pins, set the others to 0:
   this->motor_pin_3 = 0;
   this->motor_pin_4 = 0;
   this->motor_pin_5 = 0;
 
-  // pin_count is used by the stepMotor() method:
+  // how the pins drive the motor:
+  this->motor_interface = STEPPER_COILS;
+
+  // pin_count is used by the writePattern() method:
   this->pin_count = 2;
+
+  // coil sequence used by the stepMotor() method:
+  this->sequence = sequence_2wire;
+  this->sequence_length = sizeof(sequence_2wire);
+  this->step_divider = 1;
+
+  // numerator of the step delay in us for a speed in RPM, see setSpeed():
+  setRpmNumerator();
+
+  setupPorts();
 }
 
 
@@ -114,10 +237,27 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2)
 Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
                                       int motor_pin_3, int motor_pin_4)
 {
-  this->step_number = 0;    // which step the motor is on
+  this->step_number = 0;    // which step of the sequence the motor is on
   this->direction = 0;      // motor direction
   this->last_step_time = 0; // timestamp in us of the last step taken
   this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->current_position = 0; // position in steps since construction
+  this->target_position = 0;  // position run() is moving towards
+  this->ramp = 0;             // no acceleration ramp
+  this->step_delay = 0;       // no speed set yet
+#ifdef STEPPER_ENABLE_STATS
+  clearStats();
+#endif
+  this->released = false;     // coils on
+  this->fixed_rate = false;   // steps timed from when the last one was taken
+  this->low_power = false;    // busy wait between steps
+  this->step_fraction = 0;    // whole us step delay
+  this->fraction_sum = 0;     // no fractions of a us left over
+  this->microstep_stride = 0; // coils switched fully on or off
+  this->release_delay = 0;    // no auto-release
+  this->speed_direction = 0;  // runSpeed() stopped
+  this->halt_requested = false; // no stop asked for
+  this->shift_register = 0;   // pins on the board, or not yet added
 
   // Arduino pins for the motor control connection:
   this->motor_pin_1 = motor_pin_1;
@@ -126,16 +266,29 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
   this->motor_pin_4 = motor_pin_4;
 
   // setup the pins on the microcontroller:
-  pinMode(this->motor_pin_1, OUTPUT);
-  pinMode(this->motor_pin_2, OUTPUT);
-  pinMode(this->motor_pin_3, OUTPUT);
-  pinMode(this->motor_pin_4, OUTPUT);
+  outputPin(this->motor_pin_1);
+  outputPin(this->motor_pin_2);
+  outputPin(this->motor_pin_3);
+  outputPin(this->motor_pin_4);
 
   // When there are 4 pins, set the others to 0:
   this->motor_pin_5 = 0;
 
-  // pin_count is used by the stepMotor() method:
+  // how the pins drive the motor:
+  this->motor_interface = STEPPER_COILS;
+
+  // pin_count is used by the writePattern() method:
   this->pin_count = 4;
+
+  // coil sequence used by the stepMotor() method:
+  this->sequence = sequence_4wire;
+  this->sequence_length = sizeof(sequence_4wire);
+  this->step_divider = 1;
+
+  // numerator of the step delay in us for a speed in RPM, see setSpeed():
+  setRpmNumerator();
+
+  setupPorts();
 }
 
 /*
@@ -146,10 +299,27 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
                                       int motor_pin_3, int motor_pin_4,
                                       int motor_pin_5)
 {
-  this->step_number = 0;    // which step the motor is on
+  this->step_number = 0;    // which step of the sequence the motor is on
   this->direction = 0;      // motor direction
   this->last_step_time = 0; // timestamp in us of the last step taken
   this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->current_position = 0; // position in steps since construction
+  this->target_position = 0;  // position run() is moving towards
+  this->ramp = 0;             // no acceleration ramp
+  this->step_delay = 0;       // no speed set yet
+#ifdef STEPPER_ENABLE_STATS
+  clearStats();
+#endif
+  this->released = false;     // coils on
+  this->fixed_rate = false;   // steps timed from when the last one was taken
+  this->low_power = false;    // busy wait between steps
+  this->step_fraction = 0;    // whole us step delay
+  this->fraction_sum = 0;     // no fractions of a us left over
+  this->microstep_stride = 0; // coils switched fully on or off
+  this->release_delay = 0;    // no auto-release
+  this->speed_direction = 0;  // runSpeed() stopped
+  this->halt_requested = false; // no stop asked for
+  this->shift_register = 0;   // pins on the board, or not yet added
 
   // Arduino pins for the motor control connection:
   this->motor_pin_1 = motor_pin_1;
@@ -159,73 +329,981 @@ Stepper::Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
   this->motor_pin_5 = motor_pin_5;
 
   // setup the pins on the microcontroller:
-  pinMode(this->motor_pin_1, OUTPUT);
-  pinMode(this->motor_pin_2, OUTPUT);
-  pinMode(this->motor_pin_3, OUTPUT);
-  pinMode(this->motor_pin_4, OUTPUT);
-  pinMode(this->motor_pin_5, OUTPUT);
+  outputPin(this->motor_pin_1);
+  outputPin(this->motor_pin_2);
+  outputPin(this->motor_pin_3);
+  outputPin(this->motor_pin_4);
+  outputPin(this->motor_pin_5);
 
-  // pin_count is used by the stepMotor() method:
+  // how the pins drive the motor:
+  this->motor_interface = STEPPER_COILS;
+
+  // pin_count is used by the writePattern() method:
   this->pin_count = 5;
+
+  // coil sequence used by the stepMotor() method:
+  this->sequence = sequence_5wire;
+  this->sequence_length = sizeof(sequence_5wire);
+  this->step_divider = 1;
+
+  // numerator of the step delay in us for a speed in RPM, see setSpeed():
+  setRpmNumerator();
+
+  setupPorts();
+}
+
+/*
+ *   constructor for a step and direction driver (A4988, DRV8825, TMC...)
+ *   Sets which wires should control the driver.  With microstepping,
+ *   number_of_steps counts microsteps.
+ */
+Stepper::Stepper(int number_of_steps, StepperInterface motor_interface,
+                                      int step_pin, int dir_pin)
+{
+  this->step_number = 0;    // which step of the sequence the motor is on
+  this->direction = 0;      // motor direction
+  this->last_step_time = 0; // timestamp in us of the last step taken
+  this->number_of_steps = number_of_steps; // total number of steps for this motor
+  this->current_position = 0; // position in steps since construction
+  this->target_position = 0;  // position run() is moving towards
+  this->ramp = 0;             // no acceleration ramp
+  this->step_delay = 0;       // no speed set yet
+#ifdef STEPPER_ENABLE_STATS
+  clearStats();
+#endif
+  this->released = false;     // coils on
+  this->fixed_rate = false;   // steps timed from when the last one was taken
+  this->low_power = false;    // busy wait between steps
+  this->step_fraction = 0;    // whole us step delay
+  this->fraction_sum = 0;     // no fractions of a us left over
+  this->microstep_stride = 0; // coils switched fully on or off
+  this->release_delay = 0;    // no auto-release
+  this->speed_direction = 0;  // runSpeed() stopped
+  this->halt_requested = false; // no stop asked for
+  this->shift_register = 0;   // pins on the board, or not yet added
+
+  // Arduino pins for the driver connection, step first:
+  this->motor_pin_1 = step_pin;
+  this->motor_pin_2 = dir_pin;
+
+  // setup the pins on the microcontroller:
+  outputPin(this->motor_pin_1);
+  outputPin(this->motor_pin_2);
+
+  // When there are only 2 pins, set the others to 0:
+  this->motor_pin_3 = 0;
+  this->motor_pin_4 = 0;
+  this->motor_pin_5 = 0;
+
+  // how the pins drive the motor:
+  this->motor_interface = motor_interface;
+
+  // pin_count is used by the writePattern() method:
+  this->pin_count = 2;
+
+  // the driver sequences the coils itself:
+  this->sequence = sequence_2wire;
+  this->sequence_length = sizeof(sequence_2wire);
+  this->step_divider = 1;
+
+  // shortest step pulse and direction setup time, in us, see setDriverTiming():
+  this->pulse_width = 2;
+  this->direction_setup = 2;
+  this->driver_direction = 0;
+
+  // numerator of the step delay in us for a speed in RPM, see setSpeed():
+  setRpmNumerator();
+
+  setupPorts();
+  writePattern(0b00);
+}
+
+/*
+ * Gives the motor's acceleration ramp, if any, back for another motor.
+ * Not through setAcceleration(), which would link the table of ramps in
+ * for every sketch.
+ */
+Stepper::~Stepper()
+{
+  if (this->ramp != 0)
+    this->ramp->acceleration = 0;
 }
 
 /*
- * Sets the speed in revs per minute
+ * Sets the speed in revs per minute.  The part of the step delay that
+ * only depends on the motor is worked out in advance, in 1/256 us, so
+ * this is a single division for the delay and its fraction, and none at
+ * all when the speed is the same as the last one, e.g. when following a
+ * potentiometer that hasn't moved.
  */
 void Stepper::setSpeed(long whatSpeed)
 {
-  this->step_delay = 60L * 1000L * 1000L / this->number_of_steps / whatSpeed;
+  if (whatSpeed == this->speed_rpm)
+    return;
+
+  this->speed_rpm = whatSpeed;
+  unsigned long delay = this->rpm_numerator / whatSpeed;
+  this->step_delay = delay >> 8;
+  this->step_fraction = delay & 0xFF;
+}
+
+/*
+ * Sets the speed for runSpeed(), in steps per second.  Negative speeds
+ * turn the motor in the reverse direction, 0 stops it.  The new speed
+ * applies from the next step on, counted from the last one, or, with an
+ * acceleration set, is ramped to, see runSpeed().
+ */
+void Stepper::setSpeedStepsPerSecond(float stepsPerSecond)
+{
+  this->speed_rpm = 0;
+  if (stepsPerSecond == 0)
+  {
+    this->speed_direction = 0;
+    return;
+  }
+
+#ifdef STEPPER_ENABLE_STATS
+  if (this->speed_direction == 0)
+    this->stats_due = false;
+#endif
+  this->speed_direction = stepsPerSecond > 0 ? 1 : -1;
+  float interval = 1000000.0 / fabs(stepsPerSecond);
+  this->step_delay = interval;
+  this->step_fraction = (interval - this->step_delay) * 256;
+}
+
+/*
+ * Sets the delay between steps directly, in us.  This is the fastest way
+ * to change the speed: no division is needed.
+ */
+void Stepper::setStepInterval(unsigned long interval)
+{
+  this->speed_rpm = 0;
+  this->step_delay = interval;
+  this->step_fraction = 0;
+}
+
+/*
+ * Selects the coil sequence of a 4 wire motor: full steps with two
+ * coils on (the default), half steps, which double the resolution and
+ * smooth the motion, or wave drive, full steps with a single coil on,
+ * which halves the current drawn.  In half step mode step() and run()
+ * count half steps; call setSpeed() after setStepMode() for its RPM to
+ * take them into account.  Other motors only have full steps.
+ */
+void Stepper::setStepMode(StepperStepMode mode)
+{
+  if (this->pin_count != 4)
+    return;
+
+  // where the rotor is, in half steps, so the new sequence picks up there:
+  uint8_t half_step = ((electricalAngle() - 16) & 127) >> 4;
+
+  if (this->microstep_stride != 0)
+  {
+    // back to switching the coils fully on:
+    this->microstep_stride = 0;
+    digitalWrite(this->enable_pin_a, HIGH);
+    digitalWrite(this->enable_pin_b, HIGH);
+  }
+
+  switch (mode) {
+    case STEPPER_FULL_STEP:
+      this->sequence = sequence_4wire;
+      this->sequence_length = sizeof(sequence_4wire);
+      this->step_divider = 1;
+      this->step_number = half_step >> 1;
+      break;
+    case STEPPER_HALF_STEP:
+      this->sequence = sequence_4wire_half;
+      this->sequence_length = sizeof(sequence_4wire_half);
+      this->step_divider = 2;
+      this->step_number = half_step;
+      break;
+    case STEPPER_WAVE_DRIVE:
+      this->sequence = sequence_4wire_wave;
+      this->sequence_length = sizeof(sequence_4wire_wave);
+      this->step_divider = 1;
+      this->step_number = half_step >> 1;
+      break;
+  }
+
+  setRpmNumerator();
+}
+
+/*
+ * Drives the coils of a 4 wire motor on an H-bridge with sine and cosine
+ * currents, for smoother motion than full or half steps, by writing PWM
+ * duty cycles to the bridge's enable pins, which must be PWM pins.  Each
+ * full step is divided into microsteps steps (1, 2, 4, 8, 16 or 32), which
+ * step() and run() then count, like half steps; call setSpeed() after
+ * setMicrostepping() for its RPM to take them into account.
+ * setStepMode() goes back to full, half or wave steps.
+ */
+void Stepper::setMicrostepping(uint8_t microsteps, int enable_a_pin,
+                               int enable_b_pin)
+{
+  if (this->pin_count != 4 || this->motor_interface != STEPPER_COILS)
+    return;
+
+  // where the rotor is, so the microsteps pick up there:
+  uint8_t angle = electricalAngle();
+
+  // powers of 2 up to 32 divide the quarter sine table evenly:
+  uint8_t divider = 1;
+  while (divider < 32 && (divider << 1) <= microsteps)
+    divider <<= 1;
+
+  this->enable_pin_a = enable_a_pin;
+  this->enable_pin_b = enable_b_pin;
+  pinMode(this->enable_pin_a, OUTPUT);
+  pinMode(this->enable_pin_b, OUTPUT);
+
+  this->microstep_stride = 32 / divider;
+  this->sequence_length = 4 * divider;
+  this->step_divider = divider;
+  this->step_number = ((angle - 16) & 127) / this->microstep_stride;
+
+  setRpmNumerator();
+}
+
+/*
+ * Returns the electrical angle of the step the motor is on, in 1/128 of
+ * a turn of the coil currents: full steps are 45 degrees (16) off the
+ * coil axes, the single coil steps of half steps and wave drive are on
+ * them.
+ */
+uint8_t Stepper::electricalAngle(void)
+{
+  if (this->microstep_stride != 0)
+    return (16 + this->step_number * this->microstep_stride) & 127;
+  if (this->sequence == sequence_4wire_half)
+    return (16 + (this->step_number << 4)) & 127;
+  if (this->sequence == sequence_4wire_wave)
+    return (32 + (this->step_number << 5)) & 127;
+  return (16 + (this->step_number << 5)) & 127;
+}
+
+/*
+ * Works out the numerator of the step delay for a speed in RPM, see
+ * setSpeed(), in 1/256 us, for the number of steps per revolution.  It
+ * fits in 32 bits for motors of 4 steps per revolution or more.
+ */
+void Stepper::setRpmNumerator(void)
+{
+  unsigned long steps = (unsigned long)this->number_of_steps * this->step_divider;
+
+  this->rpm_numerator = ((60L * 1000L * 1000L / steps) << 8) +
+                        ((60L * 1000L * 1000L % steps) << 8) / steps;
+  this->speed_rpm = 0;
+}
+
+/*
+ * Sets the maximum speed in steps per second.  Without an acceleration
+ * ramp this is the same as setSpeed(), in different units.
+ */
+void Stepper::setMaxSpeed(long stepsPerSecond)
+{
+  this->speed_rpm = 0;
+  this->step_delay = 1000000L / stepsPerSecond;
+  this->step_fraction = ((1000000L % stepsPerSecond) << 8) / stepsPerSecond;
+}
+
+/*
+ * Integer square root, used when setting up the acceleration ramp.
+ */
+static unsigned long isqrt(unsigned long x)
+{
+  unsigned long root = 0;
+  unsigned long bit = 1UL << 30;
+
+  while (bit > x)
+    bit >>= 2;
+  while (bit != 0)
+  {
+    if (x >= root + bit)
+    {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    }
+    else
+    {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+/*
+ * Sets the acceleration and deceleration in steps per second per second.
+ * The motor then ramps up to the speed set by setSpeed() or setMaxSpeed()
+ * at the start of each move and back down to a stop at the end of it.
+ * 0 turns the ramps off again.  The ramp is kept in one of the
+ * STEPPER_MAX_RAMPS entries of a table, taken by the first call and given
+ * back by 0, so that motors without one don't take the RAM for it.
+ * Returns false, leaving the motor without a ramp, if they're all taken.
+ */
+bool Stepper::setAcceleration(long stepsPerSecondPerSecond)
+{
+  static StepperRamp ramps[STEPPER_MAX_RAMPS];
+  StepperRamp *ramp = this->ramp;
+
+  if (stepsPerSecondPerSecond <= 0)
+  {
+    if (ramp != 0)
+    {
+      // a pointer takes two writes on 8 bit boards, see StepperTimer:
+      noInterrupts();
+      this->ramp = 0;
+      interrupts();
+      ramp->acceleration = 0;   // free for another motor
+    }
+    return true;
+  }
+
+  if (ramp == 0)
+  {
+    uint8_t i = 0;
+    while (i < STEPPER_MAX_RAMPS && ramps[i].acceleration != 0)
+      i++;
+    if (i == STEPPER_MAX_RAMPS)
+      return false;
+    ramp = &ramps[i];
+    ramp->step = 0;             // motor at rest
+    ramp->exit_step = 0;        // moves end at rest
+  }
+  if (stepsPerSecondPerSecond > STEPPER_MAX_ACCELERATION)
+    stepsPerSecondPerSecond = STEPPER_MAX_ACCELERATION;
+  ramp->acceleration = stepsPerSecondPerSecond;
+
+  // speed gained per us of acceleration, in the units of ramp->speed,
+  // times 4096: a * 256 * 2^20 / 10^12 * 4096 ~= a * 1126 / 1024
+  ramp->accel = (ramp->acceleration * 1126UL) >> 10;
+
+  // first interval, 0.676 * sqrt(2 / a) seconds, as proposed by D. Austin
+  // ("Generate stepper-motor speed profiles in real time", 2005):
+  ramp->c0 = 956008UL * 16 / isqrt(ramp->acceleration << 8);
+  if (ramp->c0 > STEPPER_MAX_RAMP_INTERVAL)
+    ramp->c0 = STEPPER_MAX_RAMP_INTERVAL;
+  ramp->v0 = (1UL << 28) / ramp->c0;
+
+  if (ramp->step == 0)
+    ramp->interval = max(ramp->c0, this->step_delay);
+  if (this->ramp == 0)
+  {
+    noInterrupts();
+    this->ramp = ramp;
+    interrupts();
+  }
+  return true;
 }
 
 /*
  * Moves the motor steps_to_move steps.  If the number is negative,
  * the motor moves in the reverse direction.
  */
-void Stepper::step(int steps_to_move)
+void Stepper::step(long steps_to_move)
 {
-  int steps_left = abs(steps_to_move);  // how many steps to take
+  move(steps_to_move);
 
-  // determine direction based on whether steps_to_mode is + or -:
-  if (steps_to_move > 0) { this->direction = 1; }
-  if (steps_to_move < 0) { this->direction = 0; }
+  // take one step each time the delay has passed, until the target is reached:
+  while (!atTarget())
+  {
+    if (!stepIfDue())
+    {
+#ifdef STEPPER_ENABLE_STATS
+      unsigned long wait_start = micros();
+      waitForStep();
+      this->statistics.wait_time += micros() - wait_start;
+#else
+      waitForStep();
+#endif
+    }
+  }
+}
 
+/*
+ * Sets a new target position steps_to_move steps away from the current
+ * position.  The motor doesn't move until run() is called.
+ */
+void Stepper::move(long steps_to_move)
+{
+  moveTo(this->current_position + steps_to_move);
+}
 
-  // decrement the number of steps, moving one step each time:
-  while (steps_left > 0)
+/*
+ * Sets a new absolute target position.  The motor doesn't move until
+ * run() is called.
+ */
+void Stepper::moveTo(long absolute)
+{
+  this->target_position = absolute;
+  if (this->ramp)
+    this->ramp->exit_step = 0;
+#ifdef STEPPER_ENABLE_STATS
+  // the first step of a move is due whenever it's asked for:
+  this->stats_due = false;
+#endif
+}
+
+/*
+ * Returns true once the motor is at the target and slow enough to stay
+ * there: at rest, or at the exit speed StepperQueue planned for the move.
+ */
+bool Stepper::atTarget(void)
+{
+  if (this->halt_requested)
+    halt();
+  return this->current_position == this->target_position &&
+         (this->ramp == 0 || this->ramp->step <= this->ramp->exit_step);
+}
+
+/*
+ * Ends the move where the motor is, without a ramp down, and stops
+ * runSpeed(), once an interrupt has set halt_requested.  The interrupt
+ * sets only the flag: the position and target take more than one
+ * instruction to change on 8 bit boards, so they are only changed here,
+ * before the next step.  atTarget() and runSpeed() call it, and so do
+ * StepperGroup and StepperProfile, which step the motor themselves.
+ */
+void Stepper::halt(void)
+{
+  this->halt_requested = false;
+  this->target_position = this->current_position;
+  resetRamp();
+  this->speed_direction = 0;
+}
+
+/*
+ * Returns the current position, in steps from where the motor was when
+ * the Stepper object was created or setCurrentPosition() was last called.
+ */
+long Stepper::currentPosition(void)
+{
+  return this->current_position;
+}
+
+/*
+ * Declares the current position to be the given one, e.g. 0 once the
+ * motor has been moved to a known reference.  The target is reset to it
+ * as well, so the motor stops.
+ */
+void Stepper::setCurrentPosition(long position)
+{
+  this->current_position = position;
+  this->target_position = position;
+  resetRamp();
+}
+
+/*
+ * Puts the ramp back at rest, wherever a move is cut short without
+ * ramping down, so that the next move starts from the ramp's first
+ * interval again, not at the speed this one was cut short at.
+ */
+void Stepper::resetRamp(void)
+{
+  StepperRamp *ramp = this->ramp;
+  if (ramp == 0)
+    return;
+  ramp->step = 0;
+  ramp->exit_step = 0;
+  ramp->interval = max(ramp->c0, this->step_delay);
+}
+
+/*
+ * Returns the number of steps from the current position to the target,
+ * negative when the target is in the reverse direction.
+ */
+long Stepper::distanceToGo(void)
+{
+  return this->target_position - this->current_position;
+}
+
+/*
+ * Non-blocking mover: takes at most one step towards the target position,
+ * if the step delay has passed, and returns.  Call it as often as possible,
+ * e.g. once per loop().  Returns true while there are steps left to take.
+ */
+bool Stepper::run(void)
+{
+  if (atTarget())
+  {
+    if (this->release_delay != 0)
+      releaseIfIdle(micros());
+    return false;
+  }
+
+  stepIfDue();
+  return !atTarget();
+}
+
+/*
+ * Non-blocking continuous mover: takes one step in the direction set by
+ * setSpeedStepsPerSecond(), if the step delay has passed, and returns.
+ * There is no target; the motor turns until the speed is set to 0.
+ * With an acceleration set, the motor ramps to each new speed instead,
+ * slowing to a stop before turning the other way, and follows a speed
+ * that keeps changing, e.g. from a knob, as fast as the acceleration
+ * allows.  Returns true if a step was taken.
+ */
+bool Stepper::runSpeed(void)
+{
+  // on a ramp, the motor keeps turning the way it was until it has slowed
+  // down, even once the speed is set to 0 or reversed:
+  if (this->halt_requested)
+    halt();
+  bool ramping = this->ramp && this->ramp->step > 0;
+  if (this->speed_direction == 0 && !ramping)
+    return false;
+
+  unsigned long now = micros();
+  // move only if the appropriate delay has passed:
+  unsigned long interval = dueInterval();
+  if (now - this->last_step_time < interval)
+    return false;
+
+#ifdef STEPPER_ENABLE_STATS
+  if (!this->released)
+    countStep(now - this->last_step_time - interval);
+#endif
+  markStep(now, interval);
+  if (this->released)
   {
-    unsigned long now = micros();
-    // move only if the appropriate delay has passed:
-    if (now - this->last_step_time >= this->step_delay)
+    energize();
+    return true;
+  }
+
+  // keep the target just ahead, so that run() and runSpeed() agree:
+  int8_t heading = this->speed_direction;
+  if (ramping)
+    heading = this->direction ? 1 : -1;
+  this->target_position = this->current_position + heading;
+  takeStep();
+  if (this->ramp)
+    updateSpeedRamp();
+  return true;
+}
+
+/*
+ * The acceleration ramp of runSpeed(): like updateRamp(), but towards
+ * the speed alone.  The speed set is a step delay, so following it takes
+ * comparisons, and the ramp's multiplications; no division.
+ */
+void Stepper::updateSpeedRamp(void)
+{
+  // set to stop, or to turn the other way:
+  bool reversing = this->speed_direction != (this->direction ? 1 : -1);
+
+  if (this->ramp->step > 0 &&
+      (reversing || this->ramp->interval < this->step_delay))
+    decelerate();
+  else if (!reversing &&
+           (this->ramp->step == 0 || this->ramp->interval > this->step_delay))
+    accelerate();
+  // else at the speed set
+}
+
+/*
+ * Step engine hook for interrupt driven stepping: if there are steps left,
+ * takes one towards the target position right away and returns the delay
+ * in us before the next one should be taken.  Returns 0, without stepping,
+ * once the target has been reached.  Unlike run(), it doesn't look at
+ * micros(); the caller (e.g. a timer interrupt) does the timing.
+ */
+unsigned long Stepper::nextStep(void)
+{
+  if (atTarget())
+  {
+    if (this->release_delay != 0)
+      releaseIfIdle(micros());
+    return 0;
+  }
+
+  if (this->release_delay != 0)
+    this->last_step_time = micros();
+  if (this->released)
+  {
+    // energize the coils first, and step after the usual delay:
+    energize();
+  }
+  else
+  {
+#ifdef STEPPER_ENABLE_STATS
+    // the timer takes the step on time:
+    this->statistics.steps++;
+#endif
+    takeStep();
+    if (this->ramp)
+      updateRamp();
+  }
+
+  unsigned long interval = dueInterval();
+  this->fraction_sum += this->step_fraction;
+  return interval;
+}
+
+/*
+ * Takes one step towards the target position if the step delay has passed
+ * since the last one.  Returns true if a step was taken.
+ */
+bool Stepper::stepIfDue(void)
+{
+  unsigned long now = micros();
+  // move only if the appropriate delay has passed:
+  unsigned long interval = dueInterval();
+  if (now - this->last_step_time < interval)
+    return false;
+
+#ifdef STEPPER_ENABLE_STATS
+  if (!this->released)
+    countStep(now - this->last_step_time - interval);
+#endif
+  // get the timeStamp of when you stepped:
+  markStep(now, interval);
+  if (this->released)
+  {
+    // energize the coils first, and step after the usual delay:
+    energize();
+    return true;
+  }
+
+  takeStep();
+  if (this->ramp)
+    updateRamp();
+  return true;
+}
+
+/*
+ * Turns all coils off, so that the motor no longer draws holding current.
+ * The motor then only holds its position by its detent torque, if any.
+ * The position and the step in the coil sequence are kept, and the coils
+ * are turned back on, on the same step, before the next move.
+ *
+ * With 2 control wires all patterns energize the coils, so this does
+ * nothing.
+ */
+void Stepper::release(void)
+{
+  if (this->pin_count == 2)
+    return;
+
+  writePattern(0);
+  if (this->microstep_stride != 0)
+  {
+    analogWrite(this->enable_pin_a, 0);
+    analogWrite(this->enable_pin_b, 0);
+  }
+  this->released = true;
+}
+
+/*
+ * Makes run() release() the motor once it has been idle for the given
+ * time, in ms.  0, the default, keeps the coils energized.
+ */
+void Stepper::setAutoRelease(unsigned long timeout)
+{
+  this->release_delay = timeout * 1000;
+}
+
+/*
+ * Selects how step(), run() and runSpeed() time the steps.  By default
+ * each step is due step delay after the last one was actually taken, so
+ * when a step is late, all the later ones are too, and the motor runs a
+ * little slower than set.  With fixed rate on, each step is due a step
+ * delay after the last one was due, so late steps are made up for and
+ * the average speed is exactly the one set.
+ */
+void Stepper::setFixedRate(bool enable)
+{
+  this->fixed_rate = enable;
+}
+
+/*
+ * Makes step() put the CPU in idle sleep while it waits for the next
+ * step, instead of spinning, to save power between slow steps.  The CPU
+ * is only put to sleep when the step is due later than the core's clock
+ * tick, which wakes it up in time; the last part of the wait is spent as
+ * usual, in yield(), to keep the step on time.  Does nothing on boards
+ * without a known clock tick.
+ */
+void Stepper::setLowPowerIdle(bool enable)
+{
+  this->low_power = enable;
+}
+
+/*
+ * Waits a little for the next step of step(): sleeps, with low power idle
+ * on if the step is far enough off, or else yields to other work.
+ */
+void Stepper::waitForStep(void)
+{
+#ifdef STEPPER_WAKE_INTERVAL
+  if (this->low_power)
+  {
+    unsigned long elapsed = micros() - this->last_step_time;
+    unsigned long interval = dueInterval();
+    unsigned long time_left = interval > elapsed ? interval - elapsed : 0;
+#if defined(__AVR__)
+    if (time_left > STEPPER_WAKE_INTERVAL)
     {
-      // get the timeStamp of when you stepped:
-      this->last_step_time = now;
-      // increment or decrement the step number,
-      // depending on direction:
-      if (this->direction == 1)
-      {
-        this->step_number++;
-        if (this->step_number == this->number_of_steps) {
-          this->step_number = 0;
-        }
-      }
-      else
-      {
-        if (this->step_number == 0) {
-          this->step_number = this->number_of_steps;
-        }
-        this->step_number--;
-      }
-      // decrement the steps left:
-      steps_left--;
-      // step the motor to step number 0, 1, ..., {3 or 10}
-      if (this->pin_count == 5)
-        stepMotor(this->step_number % 10);
-      else
-        stepMotor(this->step_number % 4);
-    } else {
-      yield();
+      // any interrupt, at the latest Timer0's, wakes the CPU up again:
+      set_sleep_mode(SLEEP_MODE_IDLE);
+      sleep_mode();
+      return;
+    }
+#elif defined(ARDUINO_ARCH_SAMD)
+    if (time_left > STEPPER_WAKE_INTERVAL)
+    {
+      // sleep, not deep sleep, so SysTick keeps running and wakes it up:
+      SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+      __DSB();
+      __WFI();
+      return;
+    }
+#elif defined(ARDUINO_ARCH_MBED)
+    if (time_left > 2 * STEPPER_WAKE_INTERVAL)
+    {
+      // the RTOS idles the CPU until the last whole ms before the step:
+      rtos::ThisThread::sleep_for(
+        std::chrono::milliseconds(time_left / 1000 - 1));
+      return;
     }
+#endif
+  }
+#endif
+  yield();
+}
+
+/*
+ * Sets the time the next step is timed from, for a step taken at now that
+ * was due interval us after the last one, see catchUp().  Without fixed
+ * rate, steps are timed from when they were taken.
+ */
+void Stepper::markStep(unsigned long now, unsigned long interval)
+{
+  if (this->fixed_rate)
+    this->last_step_time = catchUp(this->last_step_time + interval, now,
+                                   interval);
+  else
+    this->last_step_time = now;
+  this->fraction_sum += this->step_fraction;
+}
+
+/*
+ * Returns the time to time the next step from, interval us later, for a
+ * step due at due and taken at now: when it was due, so that lateness of
+ * up to one interval is made up for with the next step, else now, so that
+ * after a longer stall, or at the start of a move, the motor doesn't rush
+ * to take the missed steps.
+ */
+unsigned long Stepper::catchUp(unsigned long due, unsigned long now,
+                               unsigned long interval)
+{
+  return now - due < interval ? due : now;
+}
+
+/*
+ * Returns the step delay, plus 1 us each time the fractions of a us of
+ * the steps so far add up to one more, so that the average delay is the
+ * one set, to 1/256 us.
+ */
+unsigned long Stepper::fractionalDelay(void)
+{
+  return this->step_delay + ((this->fraction_sum + this->step_fraction) >> 8);
+}
+
+/*
+ * Returns the delay before the next step: the ramp's while speeding up or
+ * slowing down, else the fractional step delay.
+ */
+unsigned long Stepper::dueInterval(void)
+{
+  if (this->ramp && this->ramp->interval != this->step_delay)
+    return this->ramp->interval;
+  return fractionalDelay();
+}
+
+/*
+ * Releases the motor if the auto-release timeout has passed since the
+ * last step.
+ */
+void Stepper::releaseIfIdle(unsigned long now)
+{
+  if (!this->released && now - this->last_step_time >= this->release_delay)
+    release();
+}
+
+/*
+ * Turns the coils back on, on the current step of the sequence.
+ */
+void Stepper::energize(void)
+{
+  this->released = false;
+  stepMotor(this->step_number);
+}
+
+/*
+ * Takes one step towards the target position, updating the step number
+ * and the position.
+ */
+void Stepper::takeStep(void)
+{
+  advanceStep();
+  // step the motor to step number 0, 1, ..., {3, 7 or 9}
+  stepMotor(this->step_number);
+}
+
+/*
+ * Updates the step number and the position for one step towards the
+ * target position, without changing the outputs.
+ */
+void Stepper::advanceStep(void)
+{
+  this->released = false;
+
+  // determine direction based on where the target is, unless still
+  // slowing down from a move in the other direction:
+  if (this->ramp == 0 || this->ramp->step == 0)
+  {
+    if (this->target_position > this->current_position) { this->direction = 1; }
+    if (this->target_position < this->current_position) { this->direction = 0; }
+  }
+
+  // increment or decrement the step number, wrapping around the coil
+  // sequence by comparison rather than with a modulo (a division on AVR),
+  // depending on direction:
+  if (this->direction == 1)
+  {
+    this->current_position++;
+    this->step_number++;
+    if (this->step_number == this->sequence_length) {
+      this->step_number = 0;
+    }
+  }
+  else
+  {
+    this->current_position--;
+    if (this->step_number == 0) {
+      this->step_number = this->sequence_length;
+    }
+    this->step_number--;
+  }
+}
+
+/*
+ * Returns the coil pattern of the current step number.
+ */
+uint8_t Stepper::currentPattern(void)
+{
+  return stepper_read_pattern(&this->sequence[this->step_number]);
+}
+
+/*
+ * Works out the interval before the next step of an acceleration ramp.
+ *
+ * The ramp keeps the speed v and the interval c = 1 / v.  Each step adds
+ * or subtracts a * c to the speed, so that v^2 changes by 2a per step as
+ * for a constant acceleration, and refines c with one Newton iteration
+ * c' = c * (2 - v' * c) of the reciprocal.  This needs only multiplies
+ * and shifts, no divisions, so it is cheap enough for every step even on
+ * 8 bit AVR.  Speeds are in 1/256 steps per 2^20 us, so that v * c is
+ * 2^28 when c is right.
+ *
+ * As the speed changes by the same amount per step up and down, the
+ * number of steps taken accelerating (ramp->step) is also the number of
+ * steps needed to stop.  A move can end at a speed other than 0, the one
+ * matching ramp->exit_step, when StepperQueue blends it with the next one.
+ */
+void Stepper::updateRamp(void)
+{
+  long distance = this->target_position - this->current_position;
+  bool reversing = (distance > 0 && this->direction == 0) ||
+                   (distance < 0 && this->direction == 1);
+  unsigned long steps_left = labs(distance);
+  // ramp steps to lose before the target, to arrive at the exit speed:
+  unsigned long ramp_left =
+    this->ramp->step > this->ramp->exit_step ? this->ramp->step - this->ramp->exit_step : 0;
+
+  if (this->ramp->step > 0 &&
+      (reversing || (ramp_left > 0 && steps_left <= ramp_left) ||
+       this->ramp->interval < this->step_delay))
+    decelerate();
+  else if (steps_left > 0 &&
+           (this->ramp->step == 0 || this->ramp->interval > this->step_delay))
+    accelerate();
+  // else cruise at step_delay
+}
+
+/*
+ * Refines the interval c for the new speed v: c' = c * (2 - v * c).
+ */
+static unsigned long rampInterval(unsigned long c, unsigned long v)
+{
+  long error = (long)(v * c - (1UL << 28)); // relative error of c, * 2^28
+  if (error > (1L << 27))
+    error = 1L << 27;
+  if (error < -(1L << 27))
+    error = -(1L << 27);
+  return c - (((long)c * (error >> 14)) >> 14);
+}
+
+void Stepper::accelerate(void)
+{
+  unsigned long c = this->ramp->interval;
+
+  if (this->ramp->step == 0)
+  {
+    c = this->ramp->c0;
+    this->ramp->speed = this->ramp->v0;
+    this->ramp->remainder = 0;
+  }
+  else
+  {
+    unsigned long gain = this->ramp->accel * c + this->ramp->remainder;
+    this->ramp->speed += gain >> 12;
+    this->ramp->remainder = gain & 0xFFF;
+    unsigned long previous = c;
+    c = rampInterval(c, this->ramp->speed);
+    if (this->ramp->step < 16)
+      c = rampInterval(c, this->ramp->speed); // still far from converged
+    if (c > previous)
+      c = previous;
   }
+  this->ramp->step++;
+
+  if (c < this->step_delay)
+    c = this->step_delay;
+  this->ramp->interval = c;
+}
+
+void Stepper::decelerate(void)
+{
+  unsigned long c = this->ramp->interval;
+
+  this->ramp->step--;
+  if (this->ramp->step == 0)
+  {
+    // stopped, the next move starts a new ramp:
+    this->ramp->interval = max(this->ramp->c0, this->step_delay);
+    return;
+  }
+
+  unsigned long loss = this->ramp->accel * c + this->ramp->remainder;
+  if ((loss >> 12) < this->ramp->speed - this->ramp->v0)
+    this->ramp->speed -= loss >> 12;
+  else
+    this->ramp->speed = this->ramp->v0;
+  this->ramp->remainder = loss & 0xFFF;
+  unsigned long previous = c;
+  c = rampInterval(c, this->ramp->speed);
+  if (this->ramp->step < 16)
+    c = rampInterval(c, this->ramp->speed);
+  if (c < previous)
+    c = previous;
+  if (c > this->ramp->c0)
+    c = this->ramp->c0;
+  this->ramp->interval = c;
 }
 
 /*
@@ -233,130 +1311,230 @@ void Stepper::step(int steps_to_move)
  */
 void Stepper::stepMotor(int thisStep)
 {
-  if (this->pin_count == 2) {
-    switch (thisStep) {
-      case 0:  // 01
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-      break;
-      case 1:  // 11
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, HIGH);
-      break;
-      case 2:  // 10
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-      break;
-      case 3:  // 00
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, LOW);
-      break;
-    }
+  if (this->motor_interface == STEPPER_DRIVER)
+    pulseDriver();
+  else if (this->microstep_stride != 0)
+    microStep(thisStep);
+  else
+    writePattern(stepper_read_pattern(&this->sequence[thisStep]));
+}
+
+/*
+ * Returns the size of the sine of an electrical angle, see
+ * electricalAngle(), as a PWM duty cycle.
+ */
+static uint8_t sineDuty(uint8_t angle)
+{
+  uint8_t index = angle & 31;
+  if (angle & 32)
+    index = 32 - index;  // second and fourth quarters mirror the first
+  return stepper_read_pattern(&sine_quarter[index]);
+}
+
+/*
+ * Sets the coil currents of a microstep: coil A (pins 1 and 2) follows the
+ * cosine of the electrical angle, coil B (pins 3 and 4) the sine.  The
+ * bridge inputs set the direction of each current, the enable pins its
+ * size.
+ */
+void Stepper::microStep(int thisStep)
+{
+  uint8_t sine_angle = (16 + thisStep * this->microstep_stride) & 127;
+  uint8_t cosine_angle = (sine_angle + 32) & 127;
+
+  // angles below 64 are in the positive half of the wave:
+  uint8_t pattern = (cosine_angle < 64 ? 0b1000 : 0b0100) |
+                    (sine_angle < 64 ? 0b0010 : 0b0001);
+  writePattern(pattern);
+  analogWrite(this->enable_pin_a, sineDuty(cosine_angle));
+  analogWrite(this->enable_pin_b, sineDuty(sine_angle));
+}
+
+/*
+ * Makes a step and direction driver take one step in the current
+ * direction.  The direction pin is set first, and given time to settle,
+ * when it changes.
+ */
+void Stepper::pulseDriver(void)
+{
+  uint8_t dir = this->direction ? 0b01 : 0b00;  // motor_pin_2
+
+  if (this->direction != this->driver_direction)
+  {
+    writePattern(dir);
+    this->driver_direction = this->direction;
+    delayMicroseconds(this->direction_setup);
   }
-  if (this->pin_count == 4) {
-    switch (thisStep) {
-      case 0:  // 1010
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-      break;
-      case 1:  // 0110
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-      break;
-      case 2:  //0101
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-      break;
-      case 3:  //1001
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-      break;
+  writePattern(0b10 | dir);                     // motor_pin_1 high
+  delayMicroseconds(this->pulse_width);
+  writePattern(dir);
+}
+
+/*
+ * Sets the timing requirements of a step and direction driver, in us:
+ * the shortest step pulse, and how long the direction must be set before
+ * a step pulse.  Both are 2 us by default, which suits A4988, DRV8825
+ * and TMC drivers.
+ */
+void Stepper::setDriverTiming(uint8_t pulseWidth, uint8_t directionSetup)
+{
+  this->pulse_width = pulseWidth;
+  this->direction_setup = directionSetup;
+}
+
+/*
+ * Resolves each motor pin to its port output register and bit mask, so
+ * that writePattern() doesn't need the pin lookups digitalWrite() does.
+ * Pins on the same port are grouped, to be set with a single write.  A
+ * motor with pins on more than STEPPER_MOTOR_PORTS ports, which takes
+ * unusual wiring, is left to digitalWrite(), so that the others don't
+ * take the RAM for it.
+ */
+void Stepper::setupPorts(void)
+{
+#ifdef STEPPER_DIRECT_PORT
+  int pins[5] = { this->motor_pin_1, this->motor_pin_2, this->motor_pin_3,
+                  this->motor_pin_4, this->motor_pin_5 };
+
+  this->port_count = 0;
+  this->pin_ports = 0;
+  // shift register bits have no port:
+  if (this->motor_pin_1 >= STEPPER_SHIFT_PIN(0))
+    return;
+  for (uint8_t i = 0; i < this->pin_count; i++)
+  {
+    volatile stepper_port_t *reg = portOutputRegister(digitalPinToPort(pins[i]));
+    uint8_t port = 0;
+    while (port < this->port_count && this->port_register[port] != reg)
+      port++;
+    if (port == this->port_count)
+    {
+      if (port == STEPPER_MOTOR_PORTS)
+      {
+        this->port_count = 0;
+        return;
+      }
+      this->port_register[port] = reg;
+      this->port_mask[port] = 0;
+      this->port_count++;
     }
+    this->pin_ports |= port << i;
+    this->pin_mask[i] = digitalPinToBitMask(pins[i]);
+    this->port_mask[port] |= this->pin_mask[i];
   }
+#endif
+}
 
-  if (this->pin_count == 5) {
-    switch (thisStep) {
-      case 0:  // 01101
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 1:  // 01001
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 2:  // 01011
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 3:  // 01010
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 4:  // 11010
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, HIGH);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 5:  // 10010
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, LOW);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 6:  // 10110
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, HIGH);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 7:  // 10100
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, LOW);
-        break;
-      case 8:  // 10101
-        digitalWrite(motor_pin_1, HIGH);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
-      case 9:  // 00101
-        digitalWrite(motor_pin_1, LOW);
-        digitalWrite(motor_pin_2, LOW);
-        digitalWrite(motor_pin_3, HIGH);
-        digitalWrite(motor_pin_4, LOW);
-        digitalWrite(motor_pin_5, HIGH);
-        break;
+/*
+ * Sets the motor pins to a coil pattern, most significant bit first:
+ * bit (pin_count - 1) is motor_pin_1, bit 0 is the last motor pin.
+ */
+void Stepper::writePattern(uint8_t pattern)
+{
+  if (this->motor_pin_1 >= STEPPER_SHIFT_PIN(0))
+  {
+    // the pins are shift register bits, once the motor has been added:
+    if (this->shift_register != 0)
+      shift_output(this, pattern);
+    return;
+  }
+
+#ifdef STEPPER_DIRECT_PORT
+  if (this->port_count != 0)
+  {
+    stepper_port_t value[STEPPER_MOTOR_PORTS] = { 0, 0 };
+    uint8_t bit = 1 << (this->pin_count - 1);
+
+    for (uint8_t i = 0; i < this->pin_count; i++, bit >>= 1)
+    {
+      if (pattern & bit)
+        value[(this->pin_ports >> i) & 1] |= this->pin_mask[i];
     }
+
+    writePorts(this->port_register, this->port_mask, value, this->port_count);
+    return;
+  }
+#endif
+
+  int pins[5] = { this->motor_pin_1, this->motor_pin_2, this->motor_pin_3,
+                  this->motor_pin_4, this->motor_pin_5 };
+  uint8_t bit = 1 << (this->pin_count - 1);
+
+  for (uint8_t i = 0; i < this->pin_count; i++, bit >>= 1)
+    digitalWrite(pins[i], (pattern & bit) ? HIGH : LOW);
+}
+
+#ifdef STEPPER_DIRECT_PORT
+/*
+ * Sets the bits in masks[port] of each port register to values[port],
+ * with one read-modify-write per port.  Interrupts are off meanwhile, so
+ * that nothing else writes the ports in between; their previous state is
+ * restored, so this is also safe to call from an interrupt.
+ */
+void Stepper::writePorts(volatile stepper_port_t *const registers[],
+                         const stepper_port_t masks[],
+                         const stepper_port_t values[], uint8_t count)
+{
+#if defined(__AVR__)
+  uint8_t oldSREG = SREG;
+  cli();
+#else
+  uint32_t primask = __get_PRIMASK();
+  __disable_irq();
+#endif
+  for (uint8_t port = 0; port < count; port++)
+  {
+    volatile stepper_port_t *reg = registers[port];
+    *reg = (*reg & ~masks[port]) | values[port];
+  }
+#if defined(__AVR__)
+  SREG = oldSREG;
+#else
+  __set_PRIMASK(primask);
+#endif
+}
+#endif
+
+#ifdef STEPPER_ENABLE_STATS
+/*
+ * Returns the step timing counters, since the motor was created or
+ * clearStats() was last called.  Only steps of step(), run() and
+ * runSpeed() are timed; StepperTimer's are only counted.
+ */
+StepperStats Stepper::stats(void)
+{
+  return this->statistics;
+}
+
+/*
+ * Sets the step timing counters back to 0.
+ */
+void Stepper::clearStats(void)
+{
+  this->statistics.steps = 0;
+  this->statistics.late_steps = 0;
+  this->statistics.max_lateness = 0;
+  this->statistics.wait_time = 0;
+  this->stats_due = false;
+}
+
+/*
+ * Counts a step taken lateness us after it was due.  The first step of a
+ * move isn't timed, as the motor was waiting for a target, not a step.
+ */
+void Stepper::countStep(unsigned long lateness)
+{
+  this->statistics.steps++;
+  if (this->stats_due)
+  {
+    if (lateness > STEPPER_LATE_STEP_TOLERANCE)
+      this->statistics.late_steps++;
+    if (lateness > this->statistics.max_lateness)
+      this->statistics.max_lateness = lateness;
   }
+  this->stats_due = true;
 }
+#endif
 
 /*
   version() returns the version of the library:
@@ -61,6 +61,32 @@
  *    3  0  1  0  1
  *    4  1  0  0  1
  *
+ * With 4 control wires, setStepMode() can also select half stepping,
+ * which adds a step with a single coil on between each of the above:
+ *
+ * Step C0 C1 C2 C3
+ *    1  1  0  1  0
+ *    2  0  0  1  0
+ *    3  0  1  1  0
+ *    4  0  1  0  0
+ *    5  0  1  0  1
+ *    6  0  0  0  1
+ *    7  1  0  0  1
+ *    8  1  0  0  0
+ *
+ * or wave drive, which only uses those single coil steps:
+ *
+ * Step C0 C1 C2 C3
+ *    1  0  0  1  0
+ *    2  0  1  0  0
+ *    3  0  0  0  1
+ *    4  1  0  0  0
+ *
+ * On an H-bridge whose enable pins are wired to PWM pins, setMicrostepping()
+ * drives the coils with sine and cosine currents instead: C0 and C1 set the
+ * direction of the current in one coil and C2 and C3 in the other, and the
+ * PWM duty cycles on the enable pins set their size.
+ *
  * The sequence of control signals for 2 control wires is as follows
  * (columns C1 and C2 from above):
  *
@@ -70,6 +96,23 @@
  *    3  1  0
  *    4  0  0
  *
+ * Where there aren't enough pins, the motor pins can be bits of a chain of
+ * 74HC595 shift registers or of MCP23S17 port expanders instead, given as
+ * STEPPER_SHIFT_PIN(bit); see StepperShiftRegister.
+ *
+ * Each motor takes 69 bytes of RAM on AVR boards, about 2.7 times the
+ * 26 bytes of the original Stepper class: 13 for the port registers the
+ * pins are written through (none with STEPPER_NO_DIRECT_PORT), and 56 for
+ * the rest.  Motors with an acceleration take 34 more for the ramp, from
+ * a table of STEPPER_MAX_RAMPS, see setAcceleration().  Nothing is
+ * allocated on the heap: pin numbers are kept in single bytes, and the
+ * other single byte fields are kept together, so that they don't leave
+ * padding on 32 bit boards either.  The settings that don't change while
+ * stepping share a byte, as do the fifth pin of 5 wire motors and the
+ * first enable pin of microstepping ones.  2 wire motors keep the bytes
+ * of pins 3 to 5: all motors have the same layout, so that one class,
+ * and one copy of its code, drives them all.
+ *
  * The circuits can be found at
  *
  * https://docs.arduino.cc/learn/electronics/stepper-motors#circuit
@@ -79,6 +122,82 @@
 #ifndef Stepper_h
 #define Stepper_h
 
+#include <stdint.h>
+
+// cores where the motor pins can be written through their port registers;
+// define STEPPER_NO_DIRECT_PORT to use digitalWrite() on those as well:
+#if defined(STEPPER_NO_DIRECT_PORT)
+#elif defined(__AVR__)
+#define STEPPER_DIRECT_PORT
+typedef uint8_t stepper_port_t;
+#elif defined(ARDUINO_ARCH_SAMD)
+#define STEPPER_DIRECT_PORT
+typedef uint32_t stepper_port_t;
+#endif
+
+// ports a motor's pins can be on to be written through them, see
+// setupPorts(); pin_ports has one bit per pin to tell which:
+#define STEPPER_MOTOR_PORTS 2
+
+// motor pin numbers from STEPPER_SHIFT_PIN(0) up aren't the board's, but
+// bits of the outputs of a StepperShiftRegister:
+#define STEPPER_SHIFT_PIN(bit) (0x80 + (bit))
+
+class StepperShiftRegister;
+
+// coil sequences for 4 control wires, see setStepMode():
+enum StepperStepMode {
+  STEPPER_FULL_STEP,
+  STEPPER_HALF_STEP,
+  STEPPER_WAVE_DRIVE
+};
+
+// uncomment to count steps and late steps, see stats(); this makes each
+// Stepper 17 bytes bigger.  To define it from the build flags instead,
+// define it for the library as well as for the sketch.
+// #define STEPPER_ENABLE_STATS
+
+#ifdef STEPPER_ENABLE_STATS
+// a step is late when it's taken this much after it was due, in us:
+#ifndef STEPPER_LATE_STEP_TOLERANCE
+#define STEPPER_LATE_STEP_TOLERANCE 20
+#endif
+
+// step timing counters of a motor, see Stepper::stats():
+struct StepperStats {
+  unsigned long steps;        // steps taken
+  unsigned long late_steps;   // steps taken late, by more than the tolerance
+  unsigned long max_lateness; // longest a step was taken after it was due, in us
+  unsigned long wait_time;    // time step() spent in yield(), in us
+};
+#endif
+
+// how many motors can have an acceleration ramp at once, see
+// setAcceleration(); the table of ramps takes 34 bytes per entry on AVR,
+// and is only linked in by sketches that call setAcceleration():
+#ifndef STEPPER_MAX_RAMPS
+#define STEPPER_MAX_RAMPS 4
+#endif
+
+// acceleration ramp of a motor, see Stepper::updateRamp():
+struct StepperRamp {
+  unsigned long acceleration;   // in steps/s/s, 0 while the entry is free
+  unsigned long accel;          // acceleration, scaled for the speed update
+  unsigned long c0;             // interval of the first ramp step, in us
+  unsigned long v0;             // speed matching c0
+  unsigned long speed;          // current speed, in 1/256 steps per 2^20 us
+  unsigned int remainder;       // speed update bits below 1/256
+  unsigned long step;           // steps taken accelerating, i.e. to stop
+  unsigned long exit_step;      // step to end the move at, 0 to stop
+  unsigned long interval;       // delay before the next ramp step, in us
+};
+
+// how the pins drive the motor:
+enum StepperInterface {
+  STEPPER_COILS,             // pins switch the coils, through transistors or H-bridges
+  STEPPER_DRIVER             // step and direction pins of a driver
+};
+
 // library interface description
 class Stepper {
   public:
@@ -89,32 +208,167 @@ class Stepper {
     Stepper(int number_of_steps, int motor_pin_1, int motor_pin_2,
                                  int motor_pin_3, int motor_pin_4,
                                  int motor_pin_5);
+    Stepper(int number_of_steps, StepperInterface motor_interface,
+                                 int step_pin, int dir_pin);
+    ~Stepper();
 
     // speed setter method:
     void setSpeed(long whatSpeed);
+    void setStepInterval(unsigned long interval);
+
+    // coil sequence setter methods, 4 wire motors only:
+    void setStepMode(StepperStepMode mode);
+    void setMicrostepping(uint8_t microsteps, int enable_a_pin,
+                          int enable_b_pin);
+
+    // step and direction driver setter method:
+    void setDriverTiming(uint8_t pulseWidth, uint8_t directionSetup);
+
+    // acceleration ramp setter methods:
+    void setMaxSpeed(long stepsPerSecond);
+    bool setAcceleration(long stepsPerSecondPerSecond);
 
     // mover method:
-    void step(int number_of_steps);
+    void step(long number_of_steps);
+
+    // non-blocking mover methods:
+    void move(long steps_to_move);
+    void moveTo(long absolute);
+    bool run(void);
+
+    // continuous speed methods:
+    void setSpeedStepsPerSecond(float stepsPerSecond);
+    bool runSpeed(void);
+
+    // coil current methods:
+    void release(void);
+    void setAutoRelease(unsigned long timeout);
+
+    // step timing methods:
+    void setFixedRate(bool enable);
+    void setLowPowerIdle(bool enable);
+
+    // position methods:
+    long currentPosition(void);
+    void setCurrentPosition(long position);
+    long distanceToGo(void);
+
+    // step engine hooks, used by StepperTimer and the schedulers:
+    unsigned long nextStep(void);
+    static unsigned long catchUp(unsigned long due, unsigned long now,
+                                 unsigned long interval);
+
+#ifdef STEPPER_ENABLE_STATS
+    // step timing counters:
+    StepperStats stats(void);
+    void clearStats(void);
+#endif
 
     int version(void);
 
   private:
+    friend class StepperTimer;
+    friend class StepperGroup;
+    friend class StepperQueue;
+    friend class StepperPIO;
+    friend class StepperShiftRegister;
+    friend class StepperProfile;
+    friend class StepperLimitSwitch;
+
+    bool atTarget(void);
+    void halt(void);
+    bool stepIfDue(void);
+    void takeStep(void);
+    void advanceStep(void);
+    void markStep(unsigned long now, unsigned long interval);
+    void waitForStep(void);
+    unsigned long fractionalDelay(void);
+    unsigned long dueInterval(void);
+    void setRpmNumerator(void);
+    void releaseIfIdle(unsigned long now);
+    void energize(void);
+    uint8_t currentPattern(void);
+    void updateRamp(void);
+    void updateSpeedRamp(void);
+    void accelerate(void);
+    void resetRamp(void);
+    void decelerate(void);
     void stepMotor(int this_step);
+    void microStep(int this_step);
+    uint8_t electricalAngle(void);
+    void pulseDriver(void);
+    void setupPorts(void);
+    void writePattern(uint8_t pattern);
+#ifdef STEPPER_ENABLE_STATS
+    void countStep(unsigned long lateness);
+#endif
+#ifdef STEPPER_DIRECT_PORT
+    static void writePorts(volatile stepper_port_t *const registers[],
+                           const stepper_port_t masks[],
+                           const stepper_port_t values[], uint8_t count);
+#endif
 
-    int direction;            // Direction of rotation
     unsigned long step_delay; // delay between steps, in us, based on speed
+    unsigned long rpm_numerator; // step_delay times the speed in RPM, in 1/256 us
+    long speed_rpm;           // speed last set by setSpeed(), 0 if none
+    const uint8_t *sequence;  // coil pattern of each step, in flash on AVR
+    StepperShiftRegister *shift_register; // outputs of STEPPER_SHIFT_PIN pins
+    StepperRamp *ramp;        // acceleration ramp, 0 for none
+    static void (*shift_output)(Stepper *motor, uint8_t pattern); // writes them
     int number_of_steps;      // total number of steps this motor can take
-    int pin_count;            // how many pins are in use.
-    int step_number;          // which step the motor is on
+
+    // single byte fields, kept together so they pack without padding:
+    int8_t direction;         // Direction of rotation
+    int8_t speed_direction;   // runSpeed() direction: 1, -1, or 0 to stop
+    int8_t driver_direction;  // direction the driver has been set to
+    uint8_t pulse_width;      // driver step pulse width, in us
+    uint8_t direction_setup;  // driver direction setup time, in us
+    uint8_t sequence_length;  // how many steps the sequence has
+    uint8_t step_divider;     // steps per full step, 2 when half stepping
+    uint8_t step_number;      // which step of the sequence the motor is on
+    bool released;            // whether the coils are off
+    uint8_t step_fraction;    // fraction of a us of the step delay, in 1/256 us
+    uint8_t fraction_sum;     // fractions of a us left over from past steps
+    uint8_t microstep_stride; // sine table entries per microstep, 0 if off
+    volatile bool halt_requested; // whether an interrupt asked for a stop
+
+    // settings sharing a byte; only the sketch writes them, never an
+    // interrupt, so that the writes don't clobber each other:
+    uint8_t pin_count : 3;        // how many pins are in use.
+    uint8_t motor_interface : 1;  // STEPPER_COILS or STEPPER_DRIVER
+    bool fixed_rate : 1;      // whether steps are timed from when they were due
+    bool low_power : 1;       // whether step() sleeps while it waits
 
     // motor pin numbers:
-    int motor_pin_1;
-    int motor_pin_2;
-    int motor_pin_3;
-    int motor_pin_4;
-    int motor_pin_5;          // Only 5 phase motor
+    uint8_t motor_pin_1;
+    uint8_t motor_pin_2;
+    uint8_t motor_pin_3;
+    uint8_t motor_pin_4;
+    union {                   // only 4 wire motors microstep:
+      uint8_t motor_pin_5;    // Only 5 phase motor
+      uint8_t enable_pin_a;   // H-bridge enable pins, when microstepping
+    };
+    uint8_t enable_pin_b;
+
+#ifdef STEPPER_DIRECT_PORT
+    // output registers the motor pins are on, resolved once by setupPorts():
+    uint8_t port_count;           // ports the pins are on, 0 for digitalWrite()
+    uint8_t pin_ports;            // bit i: motor pin i + 1 on the second port
+    stepper_port_t port_mask[STEPPER_MOTOR_PORTS]; // motor pins on each port
+    stepper_port_t pin_mask[5];   // bit of each motor pin in its port
+    volatile stepper_port_t *port_register[STEPPER_MOTOR_PORTS];
+#endif
 
     unsigned long last_step_time; // timestamp in us of when the last step was taken
+    unsigned long release_delay;  // idle time in us before auto-release, or 0
+
+    long current_position;    // absolute position, in steps
+    long target_position;     // position run() is moving towards
+
+#ifdef STEPPER_ENABLE_STATS
+    StepperStats statistics;
+    bool stats_due;           // whether last_step_time is when a step was due
+#endif
 };
 
 #endif
@@ -0,0 +1,209 @@
+/*
+ * StepperGroup.cpp - Coordinated multi-axis moves for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Arduino.h"
+#include "StepperGroup.h"
+
+/*
+ * constructor, for an empty group.
+ */
+StepperGroup::StepperGroup(void)
+{
+  this->motor_count = 0;
+  this->steps_total = 0;
+  this->steps_done = 0;
+  this->step_delay = 0;
+  this->step_fraction = 0;
+  this->fraction_sum = 0;
+  this->last_step_time = 0;
+#ifdef STEPPER_DIRECT_PORT
+  this->port_count = 0;
+#endif
+}
+
+/*
+ * Adds a motor to the group.  Returns false if the group is already full.
+ */
+bool StepperGroup::addStepper(Stepper &motor)
+{
+  if (this->motor_count == STEPPER_GROUP_MAX_MOTORS)
+    return false;
+
+  uint8_t index = this->motor_count++;
+  this->motors[index] = &motor;
+
+#ifdef STEPPER_DIRECT_PORT
+  // drivers need a step pulse, not just a new pattern, and shift register
+  // bits and pins on too many ports aren't written through the ports:
+  if (motor.motor_interface != STEPPER_COILS || motor.port_count == 0)
+  {
+    this->port_index[index][0] = 0xFF;
+    return true;
+  }
+
+  // find the group port of each of the motor's ports, adding new ones:
+  for (uint8_t port = 0; port < motor.port_count; port++)
+  {
+    uint8_t group_port = 0;
+    while (group_port < this->port_count &&
+           this->port_register[group_port] != motor.port_register[port])
+      group_port++;
+    if (group_port == this->port_count)
+    {
+      if (this->port_count == STEPPER_GROUP_MAX_PORTS)
+      {
+        // no room left, this motor writes its own ports:
+        this->port_index[index][0] = 0xFF;
+        return true;
+      }
+      this->port_register[this->port_count++] = motor.port_register[port];
+    }
+    this->port_index[index][port] = group_port;
+  }
+#endif
+  return true;
+}
+
+/*
+ * Sets new absolute target positions, one per motor in the order they
+ * were added.  The move is carried out by subsequent calls to run().
+ */
+void StepperGroup::moveTo(const long positions[])
+{
+  uint8_t lead = 0;
+
+  this->steps_total = 0;
+  for (uint8_t i = 0; i < this->motor_count; i++)
+  {
+    Stepper *motor = this->motors[i];
+    motor->moveTo(positions[i]);
+    this->steps[i] = labs(motor->target_position - motor->current_position);
+    if (this->steps[i] > this->steps_total)
+    {
+      this->steps_total = this->steps[i];
+      lead = i;
+    }
+  }
+
+  // start each error term half way, so the steps are centered on the line:
+  for (uint8_t i = 0; i < this->motor_count; i++)
+    this->error[i] = this->steps_total >> 1;
+
+  this->steps_done = 0;
+  if (this->motor_count > 0)
+  {
+    this->step_delay = this->motors[lead]->step_delay;
+    this->step_fraction = this->motors[lead]->step_fraction;
+  }
+}
+
+/*
+ * Non-blocking mover: if the step delay has passed, steps each motor that
+ * is due a step on the line to the target, then returns.  Call it as
+ * often as possible.  Returns true while the move is not finished.
+ */
+bool StepperGroup::run(void)
+{
+  if (this->steps_done == this->steps_total)
+    return false;
+
+  // a limit switch on any of the motors ends the move for all of them,
+  // so that the others don't go on along the line without it:
+  for (uint8_t i = 0; i < this->motor_count; i++)
+  {
+    if (this->motors[i]->halt_requested)
+    {
+      for (uint8_t j = 0; j < this->motor_count; j++)
+        this->motors[j]->halt();
+      this->steps_done = this->steps_total;
+      return false;
+    }
+  }
+
+  unsigned long now = micros();
+  // move only if the appropriate delay has passed, adding up the fractions
+  // of a us to keep the average delay exact:
+  unsigned long interval = this->step_delay +
+                           ((this->fraction_sum + this->step_fraction) >> 8);
+  if (now - this->last_step_time >= interval)
+  {
+    this->last_step_time = now;
+    this->fraction_sum += this->step_fraction;
+    stepMotors();
+    this->steps_done++;
+  }
+  return this->steps_done != this->steps_total;
+}
+
+/*
+ * Takes one tick of the move: steps each motor whose error term says so.
+ */
+void StepperGroup::stepMotors(void)
+{
+#ifdef STEPPER_DIRECT_PORT
+  stepper_port_t mask[STEPPER_GROUP_MAX_PORTS];
+  stepper_port_t value[STEPPER_GROUP_MAX_PORTS];
+
+  for (uint8_t port = 0; port < this->port_count; port++)
+  {
+    mask[port] = 0;
+    value[port] = 0;
+  }
+#endif
+
+  for (uint8_t i = 0; i < this->motor_count; i++)
+  {
+    this->error[i] -= this->steps[i];
+    if (this->error[i] >= 0)
+      continue;
+    this->error[i] += this->steps_total;
+
+    Stepper *motor = this->motors[i];
+#ifdef STEPPER_DIRECT_PORT
+    if (this->port_index[i][0] != 0xFF && motor->microstep_stride == 0)
+    {
+      // merge the motor's new pattern into the port writes:
+      motor->advanceStep();
+      uint8_t pattern = motor->currentPattern();
+      uint8_t bit = 1 << (motor->pin_count - 1);
+      for (uint8_t pin = 0; pin < motor->pin_count; pin++, bit >>= 1)
+      {
+        uint8_t port = this->port_index[i][(motor->pin_ports >> pin) & 1];
+        mask[port] |= motor->pin_mask[pin];
+        if (pattern & bit)
+          value[port] |= motor->pin_mask[pin];
+      }
+      continue;
+    }
+#endif
+    motor->takeStep();
+  }
+
+#ifdef STEPPER_DIRECT_PORT
+  Stepper::writePorts(this->port_register, mask, value, this->port_count);
+#endif
+}
+
+/*
+ * Blocking mover: returns once all motors have reached their target.
+ */
+void StepperGroup::runToPosition(void)
+{
+  while (run())
+    yield();
+}
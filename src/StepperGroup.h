@@ -0,0 +1,87 @@
+/*
+ * StepperGroup.h - Coordinated multi-axis moves for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Moves several Stepper motors together, so that they all start and
+ * arrive at the same time and the path between is a straight line.
+ *
+ * The motor with the longest move sets the pace, at the speed set with
+ * its setSpeed().  At each of its steps, the other motors step or not
+ * as decided by Bresenham's line algorithm, with integer error terms.
+ *
+ * Where the motor pins are written through their port registers (see
+ * STEPPER_DIRECT_PORT), the new coil patterns of all motors stepping in
+ * the same tick are merged, and each port is written once per tick, not
+ * once per motor.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperGroup_h
+#define StepperGroup_h
+
+#include "Stepper.h"
+
+// how many motors a group can hold:
+#ifndef STEPPER_GROUP_MAX_MOTORS
+#define STEPPER_GROUP_MAX_MOTORS 4
+#endif
+
+// how many ports the motors of a group can be on, for merged writes:
+#ifndef STEPPER_GROUP_MAX_PORTS
+#define STEPPER_GROUP_MAX_PORTS 6
+#endif
+
+// library interface description
+class StepperGroup {
+  public:
+    // constructor:
+    StepperGroup(void);
+
+    // adds a motor; returns false once the group is full:
+    bool addStepper(Stepper &motor);
+
+    // mover methods, one position per motor, in the order they were added:
+    void moveTo(const long positions[]);
+    bool run(void);
+    void runToPosition(void);
+
+  private:
+    void stepMotors(void);
+
+    Stepper *motors[STEPPER_GROUP_MAX_MOTORS];
+    uint8_t motor_count;         // how many motors are in the group
+
+    long steps[STEPPER_GROUP_MAX_MOTORS];  // steps each motor takes in this move
+    long error[STEPPER_GROUP_MAX_MOTORS];  // Bresenham error term of each motor
+    long steps_total;            // steps of the longest move, one per tick
+    long steps_done;             // ticks done so far
+
+    unsigned long step_delay;    // delay between ticks, in us
+    uint8_t step_fraction;       // fraction of a us of step_delay, in 1/256 us
+    uint8_t fraction_sum;        // fractions of a us left over from past ticks
+    unsigned long last_step_time; // timestamp in us of the last tick
+
+#ifdef STEPPER_DIRECT_PORT
+    // ports of all motors, for merged writes:
+    volatile stepper_port_t *port_register[STEPPER_GROUP_MAX_PORTS];
+    uint8_t port_count;          // how many ports the motors are on
+    // group port index of each motor port, 0xFF if not merged:
+    uint8_t port_index[STEPPER_GROUP_MAX_MOTORS][STEPPER_MOTOR_PORTS];
+#endif
+};
+
+#endif
@@ -0,0 +1,245 @@
+/*
+ * StepperLimitSwitch.cpp - Limit switches and homing for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StepperLimitSwitch.h"
+
+// the switch each handler calls, 0 if the handler is free:
+static StepperLimitSwitch *limit_switches[STEPPER_MAX_LIMIT_SWITCHES];
+
+static void limitHandler0(void) { limit_switches[0]->handleInterrupt(); }
+static void limitHandler1(void) { limit_switches[1]->handleInterrupt(); }
+static void limitHandler2(void) { limit_switches[2]->handleInterrupt(); }
+static void limitHandler3(void) { limit_switches[3]->handleInterrupt(); }
+
+static void (*const limit_handlers[STEPPER_MAX_LIMIT_SWITCHES])(void) = {
+  limitHandler0, limitHandler1, limitHandler2, limitHandler3
+};
+
+/*
+ * constructor, for a switch on an interrupt pin that reads pressedLevel
+ * when pressed: LOW for a switch to ground, read with the pull-up on,
+ * HIGH for one that pulls the pin up.
+ */
+StepperLimitSwitch::StepperLimitSwitch(Stepper &motor, int pin,
+                                       int pressedLevel)
+{
+  this->motor = &motor;
+  this->pin = pin;
+  this->pressed_level = pressedLevel;
+  this->slot = -1;
+  this->is_triggered = false;
+  this->has_position = false;
+  this->trigger_position = 0;
+}
+
+/*
+ * Sets up the pin and attaches the interrupt, from the switch being
+ * pressed on.  Returns false if the pin can't interrupt, or if
+ * STEPPER_MAX_LIMIT_SWITCHES switches are attached already.
+ */
+bool StepperLimitSwitch::begin(void)
+{
+  if (this->slot >= 0)
+    return true;
+
+  int interrupt = digitalPinToInterrupt(this->pin);
+#ifdef NOT_AN_INTERRUPT
+  if (interrupt == NOT_AN_INTERRUPT)
+    return false;
+#endif
+
+  uint8_t slot = 0;
+  while (slot < STEPPER_MAX_LIMIT_SWITCHES && limit_switches[slot] != 0)
+    slot++;
+  if (slot == STEPPER_MAX_LIMIT_SWITCHES)
+    return false;
+
+  pinMode(this->pin, this->pressed_level == LOW ? INPUT_PULLUP : INPUT);
+  limit_switches[slot] = this;
+  this->slot = slot;
+  attachInterrupt(interrupt, limit_handlers[slot],
+                  this->pressed_level == LOW ? FALLING : RISING);
+  return true;
+}
+
+/*
+ * Detaches the interrupt; the switch no longer stops the motor.
+ */
+void StepperLimitSwitch::end(void)
+{
+  if (this->slot < 0)
+    return;
+
+  detachInterrupt(digitalPinToInterrupt(this->pin));
+  limit_switches[this->slot] = 0;
+  this->slot = -1;
+}
+
+/*
+ * Returns true once the switch has stopped the motor, until clear().
+ * Until then, the switch doesn't stop it again, so the motor can be
+ * moved off it.
+ */
+bool StepperLimitSwitch::triggered(void)
+{
+  readPosition();
+  return this->is_triggered;
+}
+
+/*
+ * Returns the position the motor was at when the switch stopped it.
+ */
+long StepperLimitSwitch::triggerPosition(void)
+{
+  readPosition();
+  return this->trigger_position;
+}
+
+/*
+ * Lets the switch stop the motor again the next time it's pressed.
+ */
+void StepperLimitSwitch::clear(void)
+{
+  // a stop the motor hasn't acted on yet, e.g. as nothing was running it,
+  // would end its next move before the first step:
+  noInterrupts();
+  if (this->is_triggered)
+    this->motor->halt_requested = false;
+  this->is_triggered = false;
+  interrupts();
+  this->has_position = false;
+}
+
+/*
+ * Keeps the motor's position, the first time it's asked for after the
+ * switch stopped the motor.  The interrupt can't read it, as it may have
+ * come in half way through a change to it; the motor takes no step after
+ * the interrupt, and stays there until given a new target.  Interrupts
+ * are off for the read, in case a StepperTimer steps the motor.
+ */
+void StepperLimitSwitch::readPosition(void)
+{
+  if (!this->is_triggered || this->has_position)
+    return;
+
+  noInterrupts();
+  this->trigger_position = this->motor->current_position;
+  interrupts();
+  this->has_position = true;
+}
+
+/*
+ * Returns true if the switch is pressed now.
+ */
+bool StepperLimitSwitch::pressed(void)
+{
+  return digitalRead(this->pin) == this->pressed_level;
+}
+
+/*
+ * Called from the interrupt: asks the motor to end its move where it is,
+ * without a ramp down, before its next step.  Only flags are written
+ * here; the motor stops itself, see Stepper::halt().  Only the first
+ * press after clear() counts, so a bouncing switch is read once.
+ */
+void StepperLimitSwitch::handleInterrupt(void)
+{
+  if (this->is_triggered)
+    return;
+
+  this->is_triggered = true;
+  this->motor->halt_requested = true;
+}
+
+/*
+ * Moves the motor up to max_travel steps with run(), until the switch
+ * stops it, or until the switch is no longer pressed.  Returns false if
+ * max_travel ran out first.
+ */
+bool StepperLimitSwitch::runUntil(long max_travel, bool until_pressed)
+{
+  Stepper *motor = this->motor;
+
+  if (until_pressed)
+    clear();
+  motor->move(max_travel);
+  while (motor->run())
+  {
+    if (!until_pressed && !pressed())
+    {
+      // off the switch, stop here:
+      motor->target_position = motor->current_position;
+      motor->resetRamp();
+      return true;
+    }
+    yield();
+  }
+  return until_pressed ? triggered() : !pressed();
+}
+
+/*
+ * Finds the motor's home: runs towards the switch, max_travel steps at
+ * most (negative to go in reverse), at seekSpeed steps per second, backs
+ * off at approachSpeed until the switch lets go, then comes back at
+ * approachSpeed.  The position where the switch stops the motor that
+ * time becomes position 0.  Blocks until done.  The motor's speed is
+ * set back as it was, and its acceleration is used as it is.  Returns
+ * false, leaving the position as it was, if the switch isn't found, or
+ * without moving if begin() hasn't attached the switch.
+ */
+bool StepperLimitSwitch::homing(long max_travel, long seekSpeed,
+                                long approachSpeed)
+{
+  Stepper *motor = this->motor;
+  unsigned long step_delay = motor->step_delay;
+  uint8_t step_fraction = motor->step_fraction;
+  long speed_rpm = motor->speed_rpm;
+  long clearance = max_travel < 0 ? STEPPER_HOMING_CLEARANCE
+                                  : -STEPPER_HOMING_CLEARANCE;
+  bool found = true;
+
+  if (this->slot < 0)
+    return false;
+
+  // quickly, unless the switch is pressed already:
+  motor->setMaxSpeed(seekSpeed);
+  if (!pressed())
+    found = runUntil(max_travel, true);
+
+  // slowly off the switch, a little further, then back:
+  motor->setMaxSpeed(approachSpeed);
+  if (found)
+    found = runUntil(-max_travel, false);
+  if (found)
+  {
+    motor->move(clearance);
+    while (motor->run())
+      yield();
+    found = runUntil(max_travel, true);
+  }
+
+  motor->step_delay = step_delay;
+  motor->step_fraction = step_fraction;
+  motor->speed_rpm = speed_rpm;
+  if (!found)
+    return false;
+
+  motor->setCurrentPosition(motor->current_position - triggerPosition());
+  this->trigger_position = 0;
+  return true;
+}
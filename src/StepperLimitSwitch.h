@@ -0,0 +1,90 @@
+/*
+ * StepperLimitSwitch.h - Limit switches and homing for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Stops a Stepper the moment a switch on an interrupt pin is pressed.
+ * The interrupt flags the motor to end its move before its next step,
+ * so that nothing has to poll the switch between steps.  The flag is
+ * acted on by the motor's own movers, by the step engines that use them,
+ * and by StepperGroup, which ends the move of all its motors, StepperQueue,
+ * which drops the segments left, and StepperProfile.  StepperPIO still
+ * takes the steps already in its buffers.
+ *
+ * homing() uses a switch to find a motor's home position: it runs
+ * towards the switch at a seek speed, backs off slowly until the switch
+ * lets go, then comes back slowly, and makes the position where the switch
+ * closes again position 0.
+ *
+ * attachInterrupt() can't pass the handler an argument, so each switch
+ * takes one of STEPPER_MAX_LIMIT_SWITCHES handlers, each of which calls
+ * the switch it was given to.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperLimitSwitch_h
+#define StepperLimitSwitch_h
+
+#include "Arduino.h"
+#include "Stepper.h"
+
+// how many switches can be attached at once, one handler each:
+#define STEPPER_MAX_LIMIT_SWITCHES 4
+
+// steps homing() backs off past where the switch lets go, so that the
+// switch is done bouncing before the motor comes back:
+#ifndef STEPPER_HOMING_CLEARANCE
+#define STEPPER_HOMING_CLEARANCE 8
+#endif
+
+// library interface description
+class StepperLimitSwitch {
+  public:
+    // constructor, for a switch reading pressedLevel when pressed:
+    StepperLimitSwitch(Stepper &motor, int pin, int pressedLevel);
+
+    // attaches and detaches the interrupt; false if it can't be attached:
+    bool begin(void);
+    void end(void);
+
+    // whether the switch has stopped the motor, and where:
+    bool triggered(void);
+    long triggerPosition(void);
+    void clear(void);
+
+    // whether the switch is pressed now:
+    bool pressed(void);
+
+    // finds home; false if the switch isn't found within max_travel:
+    bool homing(long max_travel, long seekSpeed, long approachSpeed);
+
+    // called from the interrupt:
+    void handleInterrupt(void);
+
+  private:
+    bool runUntil(long max_travel, bool until_pressed);
+    void readPosition(void);
+
+    Stepper *motor;              // the motor the switch stops
+    uint8_t pin;                 // the switch pin
+    uint8_t pressed_level;       // LOW or HIGH, what the pin reads pressed
+    int8_t slot;                 // handler it was given, -1 if none
+    volatile bool is_triggered;  // whether the switch has stopped the motor
+    bool has_position;           // whether trigger_position is read yet
+    long trigger_position;       // the motor position when it stopped
+};
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * StepperMulticore.cpp - Second core step engine for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StepperMulticore.h"
+
+#ifdef STEPPER_MULTICORE_SUPPORTED
+
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+// commands, the first word of each in the FIFO; the value follows:
+#define STEPPER_COMMAND_MOVE         1
+#define STEPPER_COMMAND_MOVE_TO      2
+#define STEPPER_COMMAND_MAX_SPEED    3
+#define STEPPER_COMMAND_ACCELERATION 4
+
+// commands the FIFO holds, at 2 of its 8 words each:
+#define STEPPER_FIFO_COMMANDS        4
+
+static Stepper *core1_motor = 0;         // the motor driven by core 1
+
+// published by core 1:
+static volatile long core1_position = 0;
+static volatile bool core1_running = false;
+static volatile uint32_t core1_taken = 0; // commands taken from the FIFO
+
+static uint32_t core0_sent = 0;          // commands put in the FIFO
+
+/*
+ * Carries out a command, on core 1.
+ */
+static void core1Apply(uint32_t command, long value)
+{
+  switch (command) {
+    case STEPPER_COMMAND_MOVE:
+      core1_motor->move(value);
+      break;
+    case STEPPER_COMMAND_MOVE_TO:
+      core1_motor->moveTo(value);
+      break;
+    case STEPPER_COMMAND_MAX_SPEED:
+      core1_motor->setMaxSpeed(value);
+      break;
+    case STEPPER_COMMAND_ACCELERATION:
+      core1_motor->setAcceleration(value);
+      break;
+  }
+}
+
+/*
+ * Core 1: takes each step when it's due, timed from when the last one
+ * was due, and looks for commands in between.  Lateness of up to one
+ * step is made up for with the next step, as with Stepper::setFixedRate().
+ */
+static void core1Main(void)
+{
+  uint32_t deadline = 0;
+  bool idle = true;
+
+  while (true)
+  {
+    while (multicore_fifo_rvalid())
+    {
+      uint32_t command = multicore_fifo_pop_blocking();
+      long value = (long)multicore_fifo_pop_blocking();
+      core1_taken++;
+      core1Apply(command, value);
+    }
+
+    if (!idle && (int32_t)(time_us_32() - deadline) < 0)
+      continue;
+
+    unsigned long interval = core1_motor->nextStep();
+    core1_position = core1_motor->currentPosition();
+    core1_running = interval != 0;
+    if (interval == 0)
+    {
+      idle = true;
+      continue;
+    }
+
+    // from when the step was due, see Stepper::catchUp(), but from now
+    // after waiting for a target:
+    uint32_t now = time_us_32();
+    deadline = idle ? now : Stepper::catchUp(deadline, now, interval);
+    idle = false;
+    deadline += interval;
+  }
+}
+
+/*
+ * Starts driving the motor from core 1.  From now on, use the methods of
+ * this class instead of the motor's own.  Returns false if core 1 is
+ * already driving a motor.
+ */
+bool StepperMulticore::begin(Stepper &motor)
+{
+  if (core1_motor != 0)
+    return false;
+
+  core1_motor = &motor;
+  core1_position = motor.currentPosition();
+  multicore_launch_core1(core1Main);
+  return true;
+}
+
+/*
+ * Sends a command to core 1, unless the FIFO is full.  Both words go with
+ * interrupts off, so that a command sent from an interrupt handler can't
+ * come between them.  The FIFO can't tell how many words it has room for,
+ * so the commands core 1 hasn't taken yet are counted instead: with room
+ * for both words, neither push waits for core 1 with interrupts off.
+ */
+static bool core1Send(uint32_t command, long value)
+{
+  if (core1_motor == 0)
+    return false;
+
+  uint32_t status = save_and_disable_interrupts();
+  bool sent = core0_sent - core1_taken < STEPPER_FIFO_COMMANDS;
+  if (sent)
+  {
+    multicore_fifo_push_blocking(command);
+    multicore_fifo_push_blocking((uint32_t)value);
+    core0_sent++;
+  }
+  restore_interrupts(status);
+  return sent;
+}
+
+/*
+ * Sets a new target position steps_to_move steps away from the current
+ * position.
+ */
+bool StepperMulticore::move(long steps_to_move)
+{
+  return core1Send(STEPPER_COMMAND_MOVE, steps_to_move);
+}
+
+/*
+ * Sets a new absolute target position.
+ */
+bool StepperMulticore::moveTo(long absolute)
+{
+  return core1Send(STEPPER_COMMAND_MOVE_TO, absolute);
+}
+
+/*
+ * Sets the maximum speed in steps per second, see Stepper::setMaxSpeed().
+ */
+bool StepperMulticore::setMaxSpeed(long stepsPerSecond)
+{
+  return core1Send(STEPPER_COMMAND_MAX_SPEED, stepsPerSecond);
+}
+
+/*
+ * Sets the acceleration, see Stepper::setAcceleration().
+ */
+bool StepperMulticore::setAcceleration(long stepsPerSecondPerSecond)
+{
+  return core1Send(STEPPER_COMMAND_ACCELERATION, stepsPerSecondPerSecond);
+}
+
+/*
+ * Returns the position of the motor after its last step.
+ */
+long StepperMulticore::currentPosition(void)
+{
+  return core1_position;
+}
+
+/*
+ * Returns true while the motor still has steps left to take.  A command
+ * that is still in the FIFO doesn't count yet.
+ */
+bool StepperMulticore::isRunning(void)
+{
+  return core1_running;
+}
+
+#endif
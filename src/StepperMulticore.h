@@ -0,0 +1,70 @@
+/*
+ * StepperMulticore.h - Second core step engine for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * On the RP2040 (Nano RP2040 Connect), drives one Stepper from the second
+ * core, which the sketch doesn't otherwise use.  Core 1 does nothing but
+ * take the steps, timed from the hardware timer, so the sketch, its
+ * interrupts and its networking on core 0 can't upset the step timing.
+ *
+ * Commands go to core 1 through the inter-core FIFO, two words each, and
+ * core 1 publishes the motor's position after each step in memory both
+ * cores share.  Commands are sent from core 0 only, from loop() or from
+ * interrupt handlers: each one's two words are pushed with interrupts
+ * off, so they can't be split.
+ *
+ * On other boards STEPPER_MULTICORE_SUPPORTED isn't defined and the class
+ * isn't available.  On the Portenta H7 the M4 core runs a sketch of its
+ * own: run StepperThread there, and forward commands to it from the M7
+ * with the RPC library.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperMulticore_h
+#define StepperMulticore_h
+
+#include "Arduino.h"
+#include "Stepper.h"
+
+#if defined(ARDUINO_ARCH_RP2040) && defined(__has_include)
+#if __has_include("pico/multicore.h")
+#define STEPPER_MULTICORE_SUPPORTED
+#endif
+#endif
+
+#ifdef STEPPER_MULTICORE_SUPPORTED
+
+// library interface description
+class StepperMulticore {
+  public:
+    // starts driving a motor from core 1:
+    static bool begin(Stepper &motor);
+
+    // commands; they return false, and are dropped, if the FIFO is full:
+    static bool move(long steps_to_move);
+    static bool moveTo(long absolute);
+    static bool setMaxSpeed(long stepsPerSecond);
+    static bool setAcceleration(long stepsPerSecondPerSecond);
+
+    // state of the motor, as of its last step:
+    static long currentPosition(void);
+    static bool isRunning(void);
+};
+
+#endif
+
+#endif
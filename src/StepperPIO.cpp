@@ -0,0 +1,396 @@
+/*
+ * StepperPIO.cpp - PIO waveform step engine for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StepperPIO.h"
+
+#ifdef STEPPER_PIO_SUPPORTED
+
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+/*
+ * The state machine program.  Each word it is fed holds the pattern for
+ * the pins in its low 5 bits, the first pin in bit 0, and a count in the
+ * rest; holding the pattern takes the count plus 4 clock cycles:
+ *
+ *   .wrap_target
+ *       pull block         ; wait for the next word
+ *       out pins, 5        ; write the pattern
+ *       out x, 27          ; load the count
+ *   hold:
+ *       jmp x-- hold       ; count down, one cycle each
+ *   .wrap
+ */
+static const uint16_t stepper_pio_instructions[] = {
+  0x80a0,  // pull block
+  0x6005,  // out pins, 5
+  0x603b,  // out x, 27
+  0x0043   // jmp x-- 3
+};
+
+static const pio_program_t stepper_pio_program = {
+  stepper_pio_instructions, 4, -1
+};
+
+// the state machines count 4 cycles per us, whatever the system clock:
+#define STEPPER_PIO_TICKS_PER_US 4
+#define STEPPER_PIO_MIN_TICKS 4            // the cycles of the program itself
+#define STEPPER_PIO_MAX_COUNT 0x7FFFFFFUL  // what fits in 27 bits
+
+// where the program is loaded in each PIO block, -1 if it isn't yet:
+static int8_t program_offset[2] = { -1, -1 };
+
+/*
+ * Returns the GPIO of an Arduino pin.  On Mbed OS boards the pin numbers
+ * are the board's, not the RP2040's.
+ */
+static uint8_t pinToGpio(uint8_t pin)
+{
+#ifdef ARDUINO_ARCH_MBED
+  return (uint8_t)digitalPinToPinName(pin);
+#else
+  return pin;
+#endif
+}
+
+/*
+ * Packs a pattern and how long to hold it, in us, into a word for the
+ * state machine.
+ */
+static uint32_t patternWord(uint8_t pattern, unsigned long interval)
+{
+  unsigned long count = interval * STEPPER_PIO_TICKS_PER_US;
+  if (count < STEPPER_PIO_MIN_TICKS)
+    count = STEPPER_PIO_MIN_TICKS;
+  count -= STEPPER_PIO_MIN_TICKS;
+  if (count > STEPPER_PIO_MAX_COUNT)
+    count = STEPPER_PIO_MAX_COUNT;
+  return pattern | (count << 5);
+}
+
+/*
+ * constructor, for a motor set up as usual.  Nothing is claimed until
+ * begin().
+ */
+StepperPIO::StepperPIO(Stepper &motor)
+{
+  this->motor = &motor;
+  this->pio = 0;
+  this->sm = 0;
+  this->channel[0] = 0;
+  this->channel[1] = 0;
+  this->count[0] = 0;
+  this->count[1] = 0;
+  this->oldest = 0;
+  this->queued = 0;
+}
+
+/*
+ * Hands the motor's pins to a free state machine, in either PIO block,
+ * and claims two DMA channels.  Returns false if the motor can't be
+ * driven this way: its pins aren't consecutive GPIOs, it's microstepped,
+ * or there's no state machine, program space or DMA channel left.
+ */
+bool StepperPIO::begin(void)
+{
+  Stepper *motor = this->motor;
+  uint8_t base = pinToGpio(motor->motor_pin_1);
+  const uint8_t pins[5] = { motor->motor_pin_1, motor->motor_pin_2,
+                            motor->motor_pin_3, motor->motor_pin_4,
+                            motor->motor_pin_5 };
+
+  if (this->pio != 0 || motor->microstep_stride != 0)
+    return false;
+  for (uint8_t pin = 1; pin < motor->pin_count; pin++)
+    if (pinToGpio(pins[pin]) != base + pin)
+      return false;
+
+  // find a state machine, in a block that has or can take the program:
+  PIO blocks[2] = { pio0, pio1 };
+  int sm = -1;
+  uint8_t block;
+  for (block = 0; block < 2 && sm < 0; block++)
+  {
+    if (program_offset[block] < 0 &&
+        !pio_can_add_program(blocks[block], &stepper_pio_program))
+      continue;
+    sm = pio_claim_unused_sm(blocks[block], false);
+  }
+  if (sm < 0)
+    return false;
+  block--;
+
+  int channel_a = dma_claim_unused_channel(false);
+  int channel_b = dma_claim_unused_channel(false);
+  if (channel_a < 0 || channel_b < 0)
+  {
+    if (channel_a >= 0)
+      dma_channel_unclaim(channel_a);
+    pio_sm_unclaim(blocks[block], sm);
+    return false;
+  }
+
+  PIO pio = blocks[block];
+  if (program_offset[block] < 0)
+    program_offset[block] = pio_add_program(pio, &stepper_pio_program);
+  uint8_t offset = program_offset[block];
+
+  // start from the motor's present pattern:
+  uint8_t pattern = pinPattern();
+  for (uint8_t pin = 0; pin < motor->pin_count; pin++)
+    pio_gpio_init(pio, base + pin);
+  pio_sm_set_pins_with_mask(pio, sm, (uint32_t)pattern << base,
+                            ((1UL << motor->pin_count) - 1) << base);
+  pio_sm_set_consecutive_pindirs(pio, sm, base, motor->pin_count, true);
+
+  pio_sm_config config = pio_get_default_sm_config();
+  sm_config_set_wrap(&config, offset, offset + 3);
+  sm_config_set_out_pins(&config, base, motor->pin_count);
+  sm_config_set_out_shift(&config, true, false, 32);
+  sm_config_set_fifo_join(&config, PIO_FIFO_JOIN_TX);
+  sm_config_set_clkdiv(&config, (float)clock_get_hz(clk_sys) /
+                                (1000000.0f * STEPPER_PIO_TICKS_PER_US));
+  pio_sm_init(pio, sm, offset, &config);
+  pio_sm_set_enabled(pio, sm, true);
+
+  this->pio = pio;
+  this->sm = sm;
+  this->channel[0] = channel_a;
+  this->channel[1] = channel_b;
+  this->oldest = 0;
+  this->queued = 0;
+  return true;
+}
+
+/*
+ * Returns the pattern the motor's pins are at, between steps, with the
+ * first pin in bit 0, unlike in the coil patterns.
+ */
+uint8_t StepperPIO::pinPattern(void)
+{
+  Stepper *motor = this->motor;
+  uint8_t pattern = 0;
+
+  if (motor->motor_interface != STEPPER_COILS)
+    return motor->driver_direction == 1 ? 0b10 : 0b00;
+
+  uint8_t coils = motor->currentPattern();
+  for (uint8_t pin = 0; pin < motor->pin_count; pin++)
+    if (coils & (1 << (motor->pin_count - 1 - pin)))
+      pattern |= 1 << pin;
+  return pattern;
+}
+
+/*
+ * Works out the motor's next steps into a buffer, as the state machine
+ * words that take them, up to the end of the move or of the buffer.
+ * Returns how many words it wrote.
+ */
+uint16_t StepperPIO::fill(uint8_t buffer)
+{
+  Stepper *motor = this->motor;
+  uint32_t *words = this->buffer[buffer];
+  uint32_t *backward = this->backward[buffer];
+  uint16_t count = 0;
+
+  for (uint8_t i = 0; i < (STEPPER_PIO_BUFFER_SIZE + 31) / 32; i++)
+    backward[i] = 0;
+
+  // a driver step can take three words, a coil step one:
+  while (count + 3 <= STEPPER_PIO_BUFFER_SIZE && !motor->atTarget())
+  {
+    motor->advanceStep();
+    if (motor->ramp)
+      motor->updateRamp();
+    unsigned long interval = motor->dueInterval();
+    motor->fraction_sum += motor->step_fraction;
+
+    if (motor->motor_interface == STEPPER_COILS)
+    {
+      if (!motor->direction)
+        backward[count / 32] |= 1UL << (count % 32);
+      words[count++] = patternWord(pinPattern(), interval);
+      continue;
+    }
+
+    // step on the first pin, direction on the second:
+    uint8_t dir = motor->direction ? 0b10 : 0b00;
+    if (motor->direction != motor->driver_direction)
+    {
+      words[count++] = patternWord(dir, motor->direction_setup);
+      motor->driver_direction = motor->direction;
+    }
+    if (!motor->direction)
+      backward[count / 32] |= 1UL << (count % 32);
+    words[count++] = patternWord(dir | 0b01, motor->pulse_width);
+    if (interval > motor->pulse_width)
+      interval -= motor->pulse_width;
+    else
+      interval = 0;
+    words[count++] = patternWord(dir, interval);
+  }
+  this->count[buffer] = count;
+  return count;
+}
+
+/*
+ * Starts a buffer's DMA channel feeding its words to the state machine,
+ * or chains it on to the buffer before if that one is still being fed.
+ * A finished channel doesn't start again from the top of its buffer by
+ * itself: it would read on past the end.  So each buffer is chained on
+ * to the next only once the next one is ready, and if the one before has
+ * already finished, e.g. because run() was late, this one is started
+ * here; the state machine has held the last pattern since.
+ */
+void StepperPIO::queueBuffer(uint8_t buffer)
+{
+  uint8_t channel = this->channel[buffer];
+  uint8_t previous = this->channel[buffer ^ 1];
+  dma_channel_config config = dma_channel_get_default_config(channel);
+
+  channel_config_set_transfer_data_size(&config, DMA_SIZE_32);
+  channel_config_set_read_increment(&config, true);
+  channel_config_set_write_increment(&config, false);
+  channel_config_set_dreq(&config, pio_get_dreq(this->pio, this->sm, true));
+  // chaining a channel to itself doesn't chain it at all:
+  channel_config_set_chain_to(&config, channel);
+  dma_channel_configure(channel, &config, &this->pio->txf[this->sm],
+                        this->buffer[buffer], this->count[buffer], false);
+
+  if (this->queued > 0)
+  {
+    config = dma_get_channel_config(previous);
+    channel_config_set_chain_to(&config, channel);
+    dma_channel_set_config(previous, &config, false);
+  }
+  // the previous channel is checked after chaining, so that this one is
+  // started, either by the chain or here, but not twice:
+  if (!dma_channel_is_busy(previous) && !dma_channel_is_busy(channel) &&
+      wordsFed(buffer) == 0)
+    dma_channel_start(channel);
+}
+
+/*
+ * Returns how many of a queued buffer's words DMA has fed to the FIFO so
+ * far, from where its channel reads next.
+ */
+uint16_t StepperPIO::wordsFed(uint8_t buffer)
+{
+  uintptr_t next = (uintptr_t)dma_channel_hw_addr(this->channel[buffer])->read_addr;
+  return (next - (uintptr_t)this->buffer[buffer]) / sizeof(uint32_t);
+}
+
+/*
+ * Returns the steps queued that the state machine hasn't taken yet,
+ * backward ones negative: those in words DMA hasn't fed it, and in words
+ * still in its FIFO, which are the last ones fed.  DMA is read before the
+ * FIFO, so a word can't be missed between the two.
+ */
+long StepperPIO::stepsUnplayed(void)
+{
+  uint16_t fed[2] = { 0, 0 };
+  for (uint8_t i = 0; i < this->queued; i++)
+  {
+    uint8_t buffer = (this->oldest + i) & 1;
+    fed[buffer] = wordsFed(buffer);
+  }
+  uint16_t waiting = pio_sm_get_tx_fifo_level(this->pio, this->sm);
+
+  long steps = 0;
+  for (uint8_t i = this->queued; i-- > 0;)
+  {
+    uint8_t buffer = (this->oldest + i) & 1;
+    uint16_t word = fed[buffer];
+    uint16_t in_fifo = waiting < word ? waiting : word;
+    word -= in_fifo;
+    waiting -= in_fifo;
+
+    for (; word < this->count[buffer]; word++)
+    {
+      // a driver steps on the words that raise its step pin:
+      if (this->motor->motor_interface != STEPPER_COILS &&
+          !(this->buffer[buffer][word] & 0b01))
+        continue;
+      if (this->backward[buffer][word / 32] & (1UL << (word % 32)))
+        steps--;
+      else
+        steps++;
+    }
+  }
+  return steps;
+}
+
+/*
+ * Returns the position of the motor after the last step the state
+ * machine took.  The motor's own currentPosition() is that of the last
+ * step worked out, up to two buffers ahead.
+ */
+long StepperPIO::currentPosition(void)
+{
+  if (this->pio == 0)
+    return this->motor->currentPosition();
+  return this->motor->currentPosition() - stepsUnplayed();
+}
+
+/*
+ * Returns the steps from the motor's position, as the state machine takes
+ * them, to the target.
+ */
+long StepperPIO::distanceToGo(void)
+{
+  if (this->pio == 0)
+    return this->motor->distanceToGo();
+  return this->motor->distanceToGo() + stepsUnplayed();
+}
+
+/*
+ * Takes back the buffers the state machine has played, and refills them
+ * with the next steps.  Call it as often as possible, and at least once
+ * per buffer played (64 steps by default, or 21 for a driver), or the
+ * state machine runs out of words and holds the last pattern, late, until
+ * the next call.  Returns true while the motor is moving.
+ */
+bool StepperPIO::run(void)
+{
+  if (this->pio == 0)
+    return false;
+
+  // the oldest buffer is done once DMA has fed all its words, and none of
+  // them is left in the FIFO, behind any of the next buffer's:
+  while (this->queued > 0)
+  {
+    uint8_t oldest = this->oldest;
+    uint16_t newer = this->queued == 2 ? wordsFed(oldest ^ 1) : 0;
+    if (wordsFed(oldest) < this->count[oldest] ||
+        pio_sm_get_tx_fifo_level(this->pio, this->sm) > newer)
+      break;
+    this->oldest ^= 1;
+    this->queued--;
+  }
+
+  while (this->queued < 2 && !this->motor->atTarget())
+  {
+    uint8_t buffer = (this->oldest + this->queued) & 1;
+    fill(buffer);
+    queueBuffer(buffer);
+    this->queued++;
+  }
+  return this->queued > 0;
+}
+
+#endif
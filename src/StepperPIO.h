@@ -0,0 +1,95 @@
+/*
+ * StepperPIO.h - PIO waveform step engine for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * On the RP2040, drives a Stepper from a PIO state machine instead of
+ * from the CPU.  run() works out the steps ahead of time, as words that
+ * each hold a pin pattern and how long to hold it, into two buffers.
+ * DMA feeds the buffers to the state machine in turn, which writes each
+ * pattern to the pins and counts out its delay, so step timing doesn't
+ * depend on interrupts or on what the sketch is doing.  While one buffer
+ * plays, run() refills the other.  If run() is late, the state machine
+ * holds the last pattern until the next buffer comes.
+ *
+ * Each motor takes one state machine, of the eight, and two DMA channels.
+ * Its pins must be consecutive GPIOs, in the order of the constructor.
+ *
+ * On other boards STEPPER_PIO_SUPPORTED isn't defined and the class
+ * isn't available.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperPIO_h
+#define StepperPIO_h
+
+#include "Arduino.h"
+#include "Stepper.h"
+
+#if defined(ARDUINO_ARCH_RP2040) && defined(__has_include)
+#if __has_include("hardware/pio.h") && __has_include("hardware/dma.h")
+#define STEPPER_PIO_SUPPORTED
+#endif
+#endif
+
+#ifdef STEPPER_PIO_SUPPORTED
+
+#include "hardware/pio.h"
+
+// how many words each of the two buffers holds:
+#ifndef STEPPER_PIO_BUFFER_SIZE
+#define STEPPER_PIO_BUFFER_SIZE 64
+#endif
+
+// library interface description
+class StepperPIO {
+  public:
+    // constructor:
+    StepperPIO(Stepper &motor);
+
+    // claims a state machine and DMA channels; false if none are free:
+    bool begin(void);
+
+    // refills the buffers; returns true while the motor is moving:
+    bool run(void);
+
+    // where the motor is, as the state machine takes the steps, and how
+    // far it has left to go:
+    long currentPosition(void);
+    long distanceToGo(void);
+
+  private:
+    uint8_t pinPattern(void);
+    uint16_t fill(uint8_t buffer);
+    void queueBuffer(uint8_t buffer);
+    uint16_t wordsFed(uint8_t buffer);
+    long stepsUnplayed(void);
+
+    Stepper *motor;              // the motor driven by the state machine
+    PIO pio;                     // its PIO block, or 0 before begin()
+    uint8_t sm;                  // its state machine in the block
+    uint8_t channel[2];          // DMA channel of each buffer
+
+    uint32_t buffer[2][STEPPER_PIO_BUFFER_SIZE];
+    uint32_t backward[2][(STEPPER_PIO_BUFFER_SIZE + 31) / 32];  // a bit per word
+    uint16_t count[2];           // words in each buffer
+    uint8_t oldest;              // buffer that plays first
+    uint8_t queued;              // how many buffers aren't taken back yet
+};
+
+#endif
+
+#endif
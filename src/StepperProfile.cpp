@@ -0,0 +1,260 @@
+/*
+ * StepperProfile.cpp - Precomputed moves for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Arduino.h"
+#include "StepperProfile.h"
+
+// entry around a difference too big for one entry, high word first:
+#define STEPPER_PROFILE_ESCAPE (-32768)
+
+/*
+ * constructor, for a profile stored in entries[size].  Nothing can be
+ * played until compile().
+ */
+StepperProfile::StepperProfile(int16_t *entries, uint16_t size)
+{
+  this->entries = entries;
+  this->size = size;
+  this->entry_count = 0;
+  this->steps = 0;
+  this->first_interval = 0;
+  this->ramp_steps = 0;
+  this->cruise_steps = 0;
+  this->cruise_delay = 0;
+  this->cruise_fraction = 0;
+  this->motor = 0;
+  this->steps_left = 0;
+  this->gap = 0;
+  this->ramp_interval = 0;
+  this->entry = 0;
+  this->fraction_sum = 0;
+  this->interval = 0;
+}
+
+/*
+ * Works out a move of steps_to_move steps, ramped as the motor would with
+ * its present setMaxSpeed() or setSpeed() and setAcceleration(), without
+ * moving it.  The motor must not be playing this profile.  Returns false
+ * if the ramp doesn't fit in the entries; nothing can be played then.
+ */
+bool StepperProfile::compile(Stepper &motor, long steps_to_move)
+{
+  unsigned long gaps = labs(steps_to_move);
+  if (gaps > 0)
+    gaps--;                    // one delay fewer than there are steps
+
+  this->steps = 0;
+  this->entry_count = 0;
+  this->first_interval = 0;
+  this->ramp_steps = 0;
+  this->cruise_delay = motor.step_delay;
+  this->cruise_fraction = motor.step_fraction;
+
+  if (motor.ramp)
+  {
+    // speed up a copy, half way at most, so the motor stays as it is:
+    StepperRamp ramp = *motor.ramp;
+    Stepper model = motor;
+    unsigned long previous = 0;
+    model.ramp = &ramp;
+    model.resetRamp();
+    while (this->ramp_steps < gaps / 2)
+    {
+      model.accelerate();
+      if (ramp.interval <= model.step_delay)
+        break;               // at full speed
+      if (this->ramp_steps == 0)
+        this->first_interval = ramp.interval;
+      else if (!store((long)(ramp.interval - previous)))
+        return false;
+      previous = ramp.interval;
+      this->ramp_steps++;
+    }
+    if (this->ramp_steps == gaps / 2 && this->ramp_steps > 0)
+    {
+      // too short to get to full speed, the middle delay is the fastest:
+      this->cruise_delay = previous;
+      this->cruise_fraction = 0;
+    }
+  }
+  this->cruise_steps = gaps - 2 * this->ramp_steps;
+  this->steps = steps_to_move;
+  return true;
+}
+
+/*
+ * Adds a difference between two delays to the ramp.  Returns false if
+ * there's no room for it.
+ */
+bool StepperProfile::store(long delta)
+{
+  if (delta > STEPPER_PROFILE_ESCAPE && delta <= 32767)
+  {
+    if (this->entry_count == this->size)
+      return false;
+    this->entries[this->entry_count++] = delta;
+    return true;
+  }
+
+  // escaped, so that it reads the same both ways:
+  if (this->size - this->entry_count < 4)
+    return false;
+  this->entries[this->entry_count++] = STEPPER_PROFILE_ESCAPE;
+  this->entries[this->entry_count++] = (int16_t)(delta >> 16);
+  this->entries[this->entry_count++] = (int16_t)(delta & 0xFFFF);
+  this->entries[this->entry_count++] = STEPPER_PROFILE_ESCAPE;
+  return true;
+}
+
+long StepperProfile::readForward(void)
+{
+  long delta = this->entries[this->entry++];
+  if (delta == STEPPER_PROFILE_ESCAPE)
+  {
+    delta = (int32_t)(((uint32_t)(uint16_t)this->entries[this->entry] << 16) |
+                      (uint16_t)this->entries[this->entry + 1]);
+    this->entry += 3;
+  }
+  return delta;
+}
+
+long StepperProfile::readBackward(void)
+{
+  long delta = this->entries[--this->entry];
+  if (delta == STEPPER_PROFILE_ESCAPE)
+  {
+    this->entry -= 3;
+    delta = (int32_t)(((uint32_t)(uint16_t)this->entries[this->entry + 1] << 16) |
+                      (uint16_t)this->entries[this->entry + 2]);
+  }
+  return delta;
+}
+
+/*
+ * Starts the compiled move on a motor at rest, from where it is.  The
+ * move is carried out by subsequent calls to run(), instead of the
+ * motor's own.
+ */
+void StepperProfile::play(Stepper &motor)
+{
+  start(motor, this->steps);
+}
+
+/*
+ * Starts the compiled move backwards, e.g. to return to where play()
+ * started.
+ */
+void StepperProfile::playReverse(Stepper &motor)
+{
+  start(motor, -this->steps);
+}
+
+void StepperProfile::start(Stepper &motor, long steps)
+{
+  // the motor's target sets the direction and keeps its position right:
+  motor.target_position = motor.current_position + steps;
+  motor.resetRamp();
+
+  this->motor = steps != 0 ? &motor : 0;
+  this->steps_left = labs(steps);
+  this->gap = 0;
+  this->entry = 0;
+  this->fraction_sum = 0;
+  this->interval = 0;
+}
+
+/*
+ * Returns the delay after the step just taken: down the ramp, level at
+ * full speed, then back up the ramp.  Each takes at most an addition.
+ */
+unsigned long StepperProfile::nextInterval(void)
+{
+  this->gap++;
+
+  if (this->gap <= this->ramp_steps)
+  {
+    if (this->gap == 1)
+      this->ramp_interval = this->first_interval;
+    else
+      this->ramp_interval += readForward();
+    return this->ramp_interval;
+  }
+
+  if (this->gap <= this->ramp_steps + this->cruise_steps)
+  {
+    // add up the fractions of a us, a whole one being the carry:
+    uint8_t sum = this->fraction_sum + this->cruise_fraction;
+    unsigned long delay = this->cruise_delay + (sum < this->fraction_sum);
+    this->fraction_sum = sum;
+    return delay;
+  }
+
+  // slowing down, the ramp backwards from its last delay:
+  if (this->gap > this->ramp_steps + this->cruise_steps + 1)
+    this->ramp_interval -= readBackward();
+  return this->ramp_interval;
+}
+
+/*
+ * Non-blocking mover: takes the next step if it's due, then returns.
+ * Call it as often as possible.  Returns true while the move is not
+ * finished.
+ */
+bool StepperProfile::run(void)
+{
+  Stepper *motor = this->motor;
+  if (motor == 0)
+    return false;
+
+  // a limit switch ends the move, see Stepper::halt():
+  if (motor->halt_requested)
+  {
+    motor->halt();
+    this->motor = 0;
+    return false;
+  }
+
+  unsigned long now = micros();
+  if (this->gap > 0)
+  {
+    if (now - motor->last_step_time < this->interval)
+      return true;
+    if (motor->fixed_rate)
+      now = Stepper::catchUp(motor->last_step_time + this->interval, now,
+                             this->interval);
+  }
+  motor->last_step_time = now;
+  motor->takeStep();
+
+  if (--this->steps_left == 0)
+  {
+    this->motor = 0;
+    return false;
+  }
+  this->interval = nextInterval();
+  return true;
+}
+
+/*
+ * Blocking mover: returns once the move is finished.
+ */
+void StepperProfile::runToPosition(void)
+{
+  while (run())
+    yield();
+}
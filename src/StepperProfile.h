@@ -0,0 +1,83 @@
+/*
+ * StepperProfile.h - Precomputed moves for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Works out a move once, with the acceleration ramp of a Stepper, and
+ * keeps it to be played again and again, e.g. the moves of a machine
+ * cycle.  Playing it takes no ramp arithmetic: the delay before each
+ * step is the one before plus a stored difference, so each step costs
+ * less and each run of the move takes exactly as long as the last.
+ *
+ * Only the speeding up is stored, as differences between the delays of
+ * successive steps, in an array of ints the sketch provides; the slowing
+ * down plays it backwards, and the steps at full speed in between are
+ * counted.  Differences that don't fit an int take four entries.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperProfile_h
+#define StepperProfile_h
+
+#include "Stepper.h"
+
+// library interface description
+class StepperProfile {
+  public:
+    // constructor, storing the ramp in entries[size]:
+    StepperProfile(int16_t *entries, uint16_t size);
+
+    // works out a move with the motor's speed and acceleration as they are:
+    bool compile(Stepper &motor, long steps_to_move);
+
+    // starts the move on a motor, forward or back the way it came:
+    void play(Stepper &motor);
+    void playReverse(Stepper &motor);
+
+    // non-blocking and blocking movers:
+    bool run(void);
+    void runToPosition(void);
+
+  private:
+    void start(Stepper &motor, long steps);
+    unsigned long nextInterval(void);
+    long readForward(void);
+    long readBackward(void);
+    bool store(long delta);
+
+    int16_t *entries;
+    uint16_t size;               // how many entries there is room for
+    uint16_t entry_count;        // how many entries the ramp takes
+
+    // the compiled move:
+    long steps;                  // steps to move, negative for reverse
+    unsigned long first_interval; // delay after the first step, in us
+    unsigned long ramp_steps;    // delays spent speeding up, and slowing down
+    unsigned long cruise_steps;  // delays at full speed, in between
+    unsigned long cruise_delay;  // delay at full speed, whole us
+    uint8_t cruise_fraction;     // fraction of a us of cruise_delay, in 1/256 us
+
+    // the move being played:
+    Stepper *motor;              // the motor playing it, 0 if none
+    unsigned long steps_left;    // steps still to take
+    unsigned long gap;           // how many delays have been worked out
+    unsigned long ramp_interval; // latest delay of the ramp, in us
+    uint16_t entry;              // next entry of the ramp to read
+    uint8_t fraction_sum;        // fractions of a us left over at full speed
+    unsigned long interval;      // delay before the next step, in us
+};
+
+#endif
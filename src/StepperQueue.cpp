@@ -0,0 +1,173 @@
+/*
+ * StepperQueue.cpp - Queued, blended moves for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Arduino.h"
+#include "StepperQueue.h"
+
+/*
+ * constructor, for an empty queue.
+ */
+StepperQueue::StepperQueue(Stepper &motor)
+{
+  this->motor = &motor;
+  this->head = 0;
+  this->count = 0;
+  this->active_steps = 0;
+  this->active_max_ramp = 0;
+}
+
+/*
+ * Adds a segment of steps_to_move steps at up to stepsPerSecond to the
+ * end of the queue.  Uses the motor's acceleration as it is now.  Returns
+ * false, and drops the segment, if the queue is full.
+ */
+bool StepperQueue::push(long steps_to_move, long stepsPerSecond)
+{
+  if (this->count == STEPPER_QUEUE_SIZE)
+    return false;
+  if (steps_to_move == 0 || stepsPerSecond <= 0)
+    return true;
+
+  uint8_t index = this->head + this->count;
+  if (index >= STEPPER_QUEUE_SIZE)
+    index -= STEPPER_QUEUE_SIZE;
+  Segment &segment = this->segments[index];
+
+  segment.steps = steps_to_move;
+  segment.interval = 1000000L / stepsPerSecond;
+  // steps to stop from the top speed, v^2 / 2a:
+  segment.max_ramp = 0;
+  if (this->motor->ramp)
+  {
+    if (stepsPerSecond > 65535L)
+      stepsPerSecond = 65535L;
+    segment.max_ramp = (unsigned long)stepsPerSecond * stepsPerSecond / 2 /
+                       this->motor->ramp->acceleration;
+  }
+  this->count++;
+
+  plan();
+  return true;
+}
+
+/*
+ * Finds how fast the running segment may end.  Going back from the last
+ * segment, which ends at rest, each junction is limited by the top speed
+ * of the segments on both sides of it, and by how fast the motor can be
+ * going and still slow down to the next junction's limit in the length
+ * of the segment after it.
+ */
+void StepperQueue::plan(void)
+{
+  if (this->active_steps == 0)
+    return;
+
+  unsigned long limit = 0;   // ramp at the end of the segment looked at
+  for (uint8_t k = this->count; k > 0; k--)
+  {
+    uint8_t index = this->head + k - 1;
+    if (index >= STEPPER_QUEUE_SIZE)
+      index -= STEPPER_QUEUE_SIZE;
+    const Segment &segment = this->segments[index];
+
+    // the fastest this segment can start at:
+    unsigned long entry = limit + labs(segment.steps);
+    if (entry > segment.max_ramp)
+      entry = segment.max_ramp;
+
+    // the segment before it, and whether the motor turns round between:
+    long previous_steps;
+    unsigned long previous_max_ramp;
+    if (k > 1)
+    {
+      uint8_t previous = index == 0 ? STEPPER_QUEUE_SIZE - 1 : index - 1;
+      previous_steps = this->segments[previous].steps;
+      previous_max_ramp = this->segments[previous].max_ramp;
+    }
+    else
+    {
+      previous_steps = this->active_steps;
+      previous_max_ramp = this->active_max_ramp;
+    }
+
+    if ((previous_steps > 0) != (segment.steps > 0))
+      limit = 0;
+    else
+      limit = entry < previous_max_ramp ? entry : previous_max_ramp;
+  }
+
+  if (this->motor->ramp)
+    this->motor->ramp->exit_step = limit;
+}
+
+/*
+ * Non-blocking mover: runs the motor and starts the next segment as soon
+ * as the running one is done.  Call it as often as possible.  Returns
+ * true while there are steps left to take.
+ */
+bool StepperQueue::run(void)
+{
+  // a limit switch ends the running segment, and drops the rest, so the
+  // motor doesn't go on with them from where it stopped:
+  if (this->motor->halt_requested)
+  {
+    this->head = 0;
+    this->count = 0;
+  }
+  if (this->motor->run())
+    return true;
+
+  if (this->count == 0)
+  {
+    this->active_steps = 0;
+    return false;
+  }
+
+  // start the next segment from where the last one ended:
+  const Segment &segment = this->segments[this->head];
+  this->motor->moveTo(this->motor->target_position + segment.steps);
+  this->motor->setStepInterval(segment.interval);
+  this->active_steps = segment.steps;
+  this->active_max_ramp = segment.max_ramp;
+  if (++this->head == STEPPER_QUEUE_SIZE)
+    this->head = 0;
+  this->count--;
+
+  plan();
+  return true;
+}
+
+/*
+ * Returns how many segments are waiting to start.
+ */
+uint8_t StepperQueue::size(void)
+{
+  return this->count;
+}
+
+/*
+ * Drops the segments waiting to start.  The running one is brought to a
+ * stop at its end.
+ */
+void StepperQueue::clear(void)
+{
+  this->head = 0;
+  this->count = 0;
+  if (this->motor->ramp)
+    this->motor->ramp->exit_step = 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * StepperQueue.h - Queued, blended moves for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Holds a short list of moves for one Stepper and runs them back to back.
+ * Each move (a segment) is a number of steps and a top speed.  The list
+ * is a fixed ring of STEPPER_QUEUE_SIZE segments, so nothing is allocated
+ * at run time.
+ *
+ * With acceleration on (see Stepper::setAcceleration()), the motor
+ * doesn't stop between segments going the same way.  Each time a segment
+ * is added, the queue looks back from the last one to find how fast the
+ * motor can pass each junction and still stop at the end of the list, or
+ * slow down in time for a slower segment, and lets the running segment
+ * end at that speed.  A segment going the other way always starts from
+ * rest.
+ *
+ * The speeds are kept as ramp lengths, the number of steps needed to
+ * stop from them, which is what the step engine counts as it ramps up
+ * and down, so planning takes no more than additions and comparisons.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperQueue_h
+#define StepperQueue_h
+
+#include "Stepper.h"
+
+// how many segments a queue can hold, waiting to run:
+#ifndef STEPPER_QUEUE_SIZE
+#define STEPPER_QUEUE_SIZE 8
+#endif
+
+// library interface description
+class StepperQueue {
+  public:
+    // constructor, for the motor the segments are for:
+    StepperQueue(Stepper &motor);
+
+    // adds a segment; returns false once the queue is full:
+    bool push(long steps_to_move, long stepsPerSecond);
+
+    // runs the segments; returns true until the last one is done:
+    bool run(void);
+
+    // segments left to start, and dropping them:
+    uint8_t size(void);
+    void clear(void);
+
+  private:
+    struct Segment {
+      long steps;                // steps to move, negative for reverse
+      unsigned long interval;    // delay between steps at the top speed, in us
+      unsigned long max_ramp;    // steps to stop from the top speed
+    };
+
+    void plan(void);
+
+    Stepper *motor;
+    Segment segments[STEPPER_QUEUE_SIZE];
+    uint8_t head;                // index of the next segment to start
+    uint8_t count;               // segments waiting to start
+
+    long active_steps;           // steps of the running segment, 0 if none
+    unsigned long active_max_ramp; // steps to stop from its top speed
+};
+
+#endif
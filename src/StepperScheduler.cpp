@@ -0,0 +1,122 @@
+/*
+ * StepperScheduler.cpp - Earliest deadline first stepping of several motors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Arduino.h"
+#include "StepperScheduler.h"
+
+/*
+ * constructor, for an empty scheduler.
+ */
+StepperScheduler::StepperScheduler(void)
+{
+  this->motor_count = 0;
+  this->moving_count = 0;
+}
+
+/*
+ * Adds a motor to the scheduler, due to be looked at right away.  Returns
+ * false if the scheduler is already full.
+ */
+bool StepperScheduler::addStepper(Stepper &motor)
+{
+  if (this->motor_count == STEPPER_SCHEDULER_MAX_MOTORS)
+    return false;
+
+  uint8_t index = this->motor_count++;
+  this->motors[index] = &motor;
+  this->moving[index] = false;
+  schedule(index, micros());
+  return true;
+}
+
+/*
+ * Non-blocking mover: steps each motor whose step is due, soonest first,
+ * and returns.  Call it as often as possible.  Returns true while any
+ * motor has steps left.
+ */
+bool StepperScheduler::run(void)
+{
+  // the soonest due motor is always first:
+  while (this->motor_count > 0)
+  {
+    unsigned long now = micros();
+    unsigned long deadline = this->deadlines[0];
+    if ((long)(now - deadline) < 0)
+      break;
+
+    unsigned long interval = this->motors[0]->nextStep();
+    if ((interval != 0) != this->moving[0])
+    {
+      this->moving[0] = interval != 0;
+      if (interval != 0)
+        this->moving_count++;
+      else
+        this->moving_count--;
+    }
+    if (interval == 0)
+      interval = STEPPER_SCHEDULER_IDLE_INTERVAL;
+
+    schedule(0, Stepper::catchUp(deadline, now, interval) + interval);
+  }
+  return this->moving_count > 0;
+}
+
+/*
+ * Returns how long, in us, until the next step is due: the time the
+ * sketch has for other work before it should call run() again.  Returns
+ * 0 if a step is due now.
+ */
+unsigned long StepperScheduler::timeToNextStep(void)
+{
+  if (this->motor_count == 0)
+    return STEPPER_SCHEDULER_IDLE_INTERVAL;
+
+  long left = (long)(this->deadlines[0] - micros());
+  return left > 0 ? left : 0;
+}
+
+/*
+ * Gives the motor at index a new deadline, and moves it to its place in
+ * the array, which is sorted otherwise.
+ */
+void StepperScheduler::schedule(uint8_t index, unsigned long deadline)
+{
+  Stepper *motor = this->motors[index];
+  bool motor_moving = this->moving[index];
+
+  // move the motors due before it up, then those due after it down:
+  while (index + 1 < this->motor_count &&
+         (long)(this->deadlines[index + 1] - deadline) <= 0)
+  {
+    this->motors[index] = this->motors[index + 1];
+    this->deadlines[index] = this->deadlines[index + 1];
+    this->moving[index] = this->moving[index + 1];
+    index++;
+  }
+  while (index > 0 && (long)(this->deadlines[index - 1] - deadline) > 0)
+  {
+    this->motors[index] = this->motors[index - 1];
+    this->deadlines[index] = this->deadlines[index - 1];
+    this->moving[index] = this->moving[index - 1];
+    index--;
+  }
+
+  this->motors[index] = motor;
+  this->deadlines[index] = deadline;
+  this->moving[index] = motor_moving;
+}
@@ -0,0 +1,75 @@
+/*
+ * StepperScheduler.h - Earliest deadline first stepping of several motors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Runs several independent Stepper motors from loop() without polling
+ * each of them every time.  The motors are kept in an array sorted by the
+ * time their next step is due, so run() only has to look at the first
+ * one, and steps only the motors that are due, through Stepper::nextStep().
+ * timeToNextStep() tells how long the sketch can do other work, or sleep,
+ * before the next step.
+ *
+ * Each step is scheduled from when the last one was due, not from when it
+ * was taken, so late steps are made up for, up to one step delay, as with
+ * Stepper::setFixedRate().  Motors that are idle are looked at again every
+ * STEPPER_SCHEDULER_IDLE_INTERVAL us, so a move set with their move() or
+ * moveTo() starts within that time.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperScheduler_h
+#define StepperScheduler_h
+
+#include "Stepper.h"
+
+// how many motors a scheduler can hold:
+#ifndef STEPPER_SCHEDULER_MAX_MOTORS
+#define STEPPER_SCHEDULER_MAX_MOTORS 8
+#endif
+
+// how often, in us, idle motors are checked for a new target:
+#ifndef STEPPER_SCHEDULER_IDLE_INTERVAL
+#define STEPPER_SCHEDULER_IDLE_INTERVAL 1000
+#endif
+
+// library interface description
+class StepperScheduler {
+  public:
+    // constructor:
+    StepperScheduler(void);
+
+    // adds a motor; returns false once the scheduler is full:
+    bool addStepper(Stepper &motor);
+
+    // steps the motors that are due; returns true while any is moving:
+    bool run(void);
+
+    // time in us until the next step is due, 0 if one is due now:
+    unsigned long timeToNextStep(void);
+
+  private:
+    void schedule(uint8_t index, unsigned long deadline);
+
+    // motors and when each is due, soonest first:
+    Stepper *motors[STEPPER_SCHEDULER_MAX_MOTORS];
+    unsigned long deadlines[STEPPER_SCHEDULER_MAX_MOTORS];
+    bool moving[STEPPER_SCHEDULER_MAX_MOTORS];  // whether it has steps left
+    uint8_t motor_count;         // how many motors are in the scheduler
+    uint8_t moving_count;        // how many of them have steps left
+};
+
+#endif
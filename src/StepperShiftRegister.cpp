@@ -0,0 +1,222 @@
+/*
+ * StepperShiftRegister.cpp - Shift register outputs for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Arduino.h"
+
+// the build only finds the SPI library for sketches that include this
+// header, or SPI.h: for the others this class isn't built, and they
+// don't build the SPI library either:
+#if defined(__has_include)
+#if __has_include(<SPI.h>)
+#define STEPPER_SHIFT_SUPPORTED
+#endif
+#endif
+
+#ifdef STEPPER_SHIFT_SUPPORTED
+
+#include "StepperShiftRegister.h"
+
+// MCP23S17 opcodes and registers, with IOCON.BANK = 0:
+#define MCP23S17_WRITE  0x40      // opcode of a write, plus address << 1
+#define MCP23S17_IODIRA 0x00      // pin directions, 0 for an output
+#define MCP23S17_IOCON  0x0A      // configuration
+#define MCP23S17_OLATA  0x14      // output latches, OLATB follows
+#define MCP23S17_HAEN   0x08      // IOCON bit enabling the address pins
+
+/*
+ * Writes consecutive registers of one MCP23S17, starting at reg.
+ */
+static void expanderWrite(uint8_t cs_pin, uint8_t address, uint8_t reg,
+                          uint8_t value_a, uint8_t value_b)
+{
+  digitalWrite(cs_pin, LOW);
+  SPI.transfer(MCP23S17_WRITE | (address << 1));
+  SPI.transfer(reg);
+  SPI.transfer(value_a);
+  SPI.transfer(value_b);
+  digitalWrite(cs_pin, HIGH);
+}
+
+/*
+ * constructor, for a chain of chip_count 74HC595s latched by cs_pin, or
+ * chip_count MCP23S17s at addresses 0, 1, ... selected by cs_pin.
+ */
+StepperShiftRegister::StepperShiftRegister(StepperExpander expander,
+                                           int cs_pin, uint8_t chip_count)
+{
+  uint8_t chip_bytes = expander == STEPPER_MCP23S17 ? 2 : 1;
+
+  // no more chips than there are outputs for:
+  if (chip_count > STEPPER_SHIFT_MAX_BYTES / chip_bytes)
+    chip_count = STEPPER_SHIFT_MAX_BYTES / chip_bytes;
+
+  this->motor_count = 0;
+  this->byte_count = chip_count * chip_bytes;
+  this->chip_count = chip_count;
+  this->expander = expander;
+  this->cs_pin = cs_pin;
+  this->started = false;
+  this->batching = false;
+  this->changed = false;
+  for (uint8_t i = 0; i < STEPPER_SHIFT_MAX_BYTES; i++)
+    this->outputs[i] = 0;
+}
+
+/*
+ * Sets up the SPI bus and the chips, and sends the outputs: all off,
+ * except for the patterns of motors that have already stepped.
+ */
+void StepperShiftRegister::begin(void)
+{
+  pinMode(this->cs_pin, OUTPUT);
+  digitalWrite(this->cs_pin, HIGH);
+  SPI.begin();
+
+  if (this->expander == STEPPER_MCP23S17)
+  {
+    SPI.beginTransaction(SPISettings(STEPPER_SHIFT_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+    // until HAEN is set, every chip answers to address 0:
+    expanderWrite(this->cs_pin, 0, MCP23S17_IOCON, MCP23S17_HAEN, MCP23S17_HAEN);
+    for (uint8_t chip = 0; chip < this->chip_count; chip++)
+      expanderWrite(this->cs_pin, chip, MCP23S17_IODIRA, 0x00, 0x00);
+    SPI.endTransaction();
+  }
+
+  this->started = true;
+  this->changed = true;
+  update();
+}
+
+/*
+ * Adds a motor whose pins are all STEPPER_SHIFT_PIN() outputs of these
+ * chips.  Returns false if there are already STEPPER_SHIFT_MAX_MOTORS,
+ * or if the motor's pins aren't outputs of these chips.
+ */
+bool StepperShiftRegister::addStepper(Stepper &motor)
+{
+  const uint8_t pins[5] = { motor.motor_pin_1, motor.motor_pin_2,
+                            motor.motor_pin_3, motor.motor_pin_4,
+                            motor.motor_pin_5 };
+
+  if (this->motor_count == STEPPER_SHIFT_MAX_MOTORS)
+    return false;
+  for (uint8_t pin = 0; pin < motor.pin_count; pin++)
+  {
+    if (pins[pin] < STEPPER_SHIFT_PIN(0) ||
+        pins[pin] >= STEPPER_SHIFT_PIN(this->byte_count * 8))
+      return false;
+  }
+
+  this->motors[this->motor_count++] = &motor;
+  motor.shift_register = this;
+  Stepper::shift_output = writeMotor;
+  return true;
+}
+
+/*
+ * Non-blocking mover: steps each motor whose step is due, as the motors'
+ * own run() does, then sends the outputs once.  Call it as often as
+ * possible.  Returns true while any of the motors is moving.
+ */
+bool StepperShiftRegister::run(void)
+{
+  bool running = false;
+
+  this->batching = true;
+  for (uint8_t i = 0; i < this->motor_count; i++)
+  {
+    if (this->motors[i]->run())
+      running = true;
+  }
+  this->batching = false;
+
+  update();
+  return running;
+}
+
+/*
+ * Sends the outputs to the chips, if any have changed since last time.
+ * Motors stepped with runSpeed() from the sketch are sent with this,
+ * once all of them have been stepped.
+ */
+void StepperShiftRegister::update(void)
+{
+  if (!this->changed || !this->started)
+    return;
+  this->changed = false;
+
+  SPI.beginTransaction(SPISettings(STEPPER_SHIFT_SPI_CLOCK, MSBFIRST, SPI_MODE0));
+  if (this->expander == STEPPER_74HC595)
+  {
+    // the last register's byte goes first, to be shifted furthest along:
+    digitalWrite(this->cs_pin, LOW);
+    for (uint8_t i = this->byte_count; i > 0; i--)
+      SPI.transfer(this->outputs[i - 1]);
+    // the outputs change together, on the rising edge of the latch:
+    digitalWrite(this->cs_pin, HIGH);
+  }
+  else
+  {
+    for (uint8_t chip = 0; chip < this->chip_count; chip++)
+      expanderWrite(this->cs_pin, chip, MCP23S17_OLATA,
+                    this->outputs[2 * chip], this->outputs[2 * chip + 1]);
+  }
+  SPI.endTransaction();
+}
+
+/*
+ * Stepper::writePattern()'s output for motors on shift register outputs,
+ * set when the first one is added.
+ */
+void StepperShiftRegister::writeMotor(Stepper *motor, uint8_t pattern)
+{
+  const uint8_t pins[5] = { motor->motor_pin_1, motor->motor_pin_2,
+                            motor->motor_pin_3, motor->motor_pin_4,
+                            motor->motor_pin_5 };
+  // a driver's step pulse can't wait for the end of the tick:
+  motor->shift_register->writePins(pins, motor->pin_count, pattern,
+                                   motor->motor_interface != STEPPER_COILS);
+}
+
+/*
+ * Sets a motor's outputs to a pattern, most significant bit first, as
+ * Stepper::writePattern() does its pins.  The outputs are sent at the end
+ * of run(), or now if now is true or run() isn't stepping the motors.
+ */
+void StepperShiftRegister::writePins(const uint8_t pins[], uint8_t count,
+                                     uint8_t pattern, bool now)
+{
+  uint8_t bit = 1 << (count - 1);
+
+  for (uint8_t i = 0; i < count; i++, bit >>= 1)
+  {
+    uint8_t output = pins[i] - STEPPER_SHIFT_PIN(0);
+    uint8_t mask = 1 << (output & 7);
+    uint8_t value = (pattern & bit) ? mask : 0;
+    if ((this->outputs[output >> 3] & mask) != value)
+    {
+      this->outputs[output >> 3] ^= mask;
+      this->changed = true;
+    }
+  }
+
+  if (now || !this->batching)
+    update();
+}
+
+#endif
@@ -0,0 +1,99 @@
+/*
+ * StepperShiftRegister.h - Shift register outputs for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Drives the pins of several Stepper motors through a chain of 74HC595
+ * shift registers, or through MCP23S17 port expanders, on the SPI bus,
+ * so that each motor takes none of the board's pins.  A motor uses the
+ * outputs given as STEPPER_SHIFT_PIN(bit) in its constructor: bit 0 is
+ * output Q0 of the register nearest the board, bit 8 Q0 of the next one,
+ * and so on, or GPA0 and GPB0 of the first expander.
+ *
+ * The outputs are kept in memory.  run() steps each motor that is due,
+ * then sends the outputs that changed in a single SPI transfer, so the
+ * bus carries one transfer per tick however many motors stepped in it.
+ * Outside run(), e.g. in step(), each new pattern is sent at once, and
+ * a driver's step pulse always is.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperShiftRegister_h
+#define StepperShiftRegister_h
+
+#include "Arduino.h"
+#include <SPI.h>
+#include "Stepper.h"
+
+// how many motors the outputs can be shared by:
+#ifndef STEPPER_SHIFT_MAX_MOTORS
+#define STEPPER_SHIFT_MAX_MOTORS 16
+#endif
+
+// how many bytes of outputs there can be, 8 outputs each:
+#ifndef STEPPER_SHIFT_MAX_BYTES
+#define STEPPER_SHIFT_MAX_BYTES 8
+#endif
+
+// SPI clock, within what both chips take:
+#ifndef STEPPER_SHIFT_SPI_CLOCK
+#define STEPPER_SHIFT_SPI_CLOCK 8000000
+#endif
+
+// chips the outputs can be on:
+enum StepperExpander {
+  STEPPER_74HC595,           // 8 outputs each, chained, latched together
+  STEPPER_MCP23S17           // 16 outputs each, sharing one chip select
+};
+
+// library interface description
+class StepperShiftRegister {
+  public:
+    // constructor, for chip_count chips selected or latched by cs_pin:
+    StepperShiftRegister(StepperExpander expander, int cs_pin,
+                         uint8_t chip_count);
+
+    // sets up the SPI bus and the chips, and clears the outputs:
+    void begin(void);
+
+    // adds a motor; returns false if it's full, or the pins don't fit:
+    bool addStepper(Stepper &motor);
+
+    // steps the motors that are due, then sends the outputs:
+    bool run(void);
+
+    // sends the outputs, if they changed:
+    void update(void);
+
+  private:
+    static void writeMotor(Stepper *motor, uint8_t pattern);
+    void writePins(const uint8_t pins[], uint8_t count, uint8_t pattern,
+                   bool now);
+
+    Stepper *motors[STEPPER_SHIFT_MAX_MOTORS];
+    uint8_t motor_count;         // how many motors have been added
+
+    uint8_t outputs[STEPPER_SHIFT_MAX_BYTES]; // output levels, bit 0 first
+    uint8_t byte_count;          // how many bytes of outputs the chips have
+    uint8_t chip_count;          // how many chips there are
+    uint8_t expander;            // STEPPER_74HC595 or STEPPER_MCP23S17
+    uint8_t cs_pin;              // the latch or chip select pin
+    bool started;                // whether begin() has been called
+    bool batching;               // whether run() is stepping the motors
+    bool changed;                // whether outputs differ from the chips'
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * StepperThread.cpp - Mbed OS motion thread for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StepperThread.h"
+
+#ifdef STEPPER_THREAD_SUPPORTED
+
+// event flags of the motion thread:
+#define STEPPER_THREAD_STEP_DUE 0x1  // the next step is due
+#define STEPPER_THREAD_COMMAND  0x2  // a command was sent
+
+// how often, in ms, the thread looks at an idle motor, for auto-release:
+#define STEPPER_THREAD_IDLE_INTERVAL 10
+
+/*
+ * constructor, for a thread that isn't started yet.
+ */
+StepperThread::StepperThread(Stepper &motor, osPriority priority)
+  : thread(priority, STEPPER_THREAD_STACK_SIZE)
+{
+  this->motor = &motor;
+  this->head = 0;
+  this->tail = 0;
+  this->position = motor.currentPosition();
+  this->running = false;
+}
+
+/*
+ * Starts the motion thread.  From now on, use the thread's methods
+ * instead of the motor's own.  Returns false if the thread couldn't be
+ * started.
+ */
+bool StepperThread::begin(void)
+{
+  return this->thread.start(mbed::callback(this, &StepperThread::loop)) == osOK;
+}
+
+/*
+ * Sets a new target position steps_to_move steps away from the current
+ * position.
+ */
+bool StepperThread::move(long steps_to_move)
+{
+  return send(COMMAND_MOVE, steps_to_move);
+}
+
+/*
+ * Sets a new absolute target position.
+ */
+bool StepperThread::moveTo(long absolute)
+{
+  return send(COMMAND_MOVE_TO, absolute);
+}
+
+/*
+ * Sets the maximum speed in steps per second, see Stepper::setMaxSpeed().
+ */
+bool StepperThread::setMaxSpeed(long stepsPerSecond)
+{
+  return send(COMMAND_MAX_SPEED, stepsPerSecond);
+}
+
+/*
+ * Sets the acceleration, see Stepper::setAcceleration().
+ */
+bool StepperThread::setAcceleration(long stepsPerSecondPerSecond)
+{
+  return send(COMMAND_ACCELERATION, stepsPerSecondPerSecond);
+}
+
+/*
+ * Returns the position of the motor after its last step.
+ */
+long StepperThread::currentPosition(void)
+{
+  return this->position;
+}
+
+/*
+ * Returns true while the motor still has steps left to take.  A command
+ * that is still in the queue doesn't count yet.
+ */
+bool StepperThread::isRunning(void)
+{
+  return this->running;
+}
+
+/*
+ * Queues a command for the motion thread and wakes it up.  Only the head
+ * is written here and only the tail by the thread, so neither has to wait.
+ */
+bool StepperThread::send(uint8_t type, long value)
+{
+  uint8_t next = this->head + 1;
+  if (next == STEPPER_THREAD_QUEUE_SIZE)
+    next = 0;
+  if (next == this->tail)
+    return false;
+
+  this->commands[this->head].type = type;
+  this->commands[this->head].value = value;
+  __DMB();  // the command is written before the thread can see it
+  this->head = next;
+
+  this->flags.set(STEPPER_THREAD_COMMAND);
+  return true;
+}
+
+/*
+ * Carries out the commands sent since the last call, in the motion thread.
+ */
+void StepperThread::applyCommands(void)
+{
+  while (this->tail != this->head)
+  {
+    __DMB();  // read the command only after seeing the new head
+    const Command &command = this->commands[this->tail];
+    switch (command.type) {
+      case COMMAND_MOVE:
+        this->motor->move(command.value);
+        break;
+      case COMMAND_MOVE_TO:
+        this->motor->moveTo(command.value);
+        break;
+      case COMMAND_MAX_SPEED:
+        this->motor->setMaxSpeed(command.value);
+        break;
+      case COMMAND_ACCELERATION:
+        this->motor->setAcceleration(command.value);
+        break;
+    }
+
+    uint8_t next = this->tail + 1;
+    if (next == STEPPER_THREAD_QUEUE_SIZE)
+      next = 0;
+    this->tail = next;
+  }
+}
+
+/*
+ * Called by the timeout, from interrupt context: the next step is due.
+ */
+void StepperThread::wake(void)
+{
+  this->flags.set(STEPPER_THREAD_STEP_DUE);
+}
+
+/*
+ * The motion thread: takes each step when it's due, timed from when the
+ * last one was due, and sleeps in between.  Lateness of up to one step
+ * is made up for with the next step, as with Stepper::setFixedRate().
+ */
+void StepperThread::loop(void)
+{
+  unsigned long deadline = 0;
+  bool idle = true;
+
+  while (true)
+  {
+    applyCommands();
+
+    if (idle || (long)(micros() - deadline) >= 0)
+    {
+      unsigned long interval = this->motor->nextStep();
+      this->position = this->motor->currentPosition();
+      this->running = interval != 0;
+
+      if (interval == 0)
+      {
+        // wait for a new target:
+        idle = true;
+        this->flags.wait_any_for(STEPPER_THREAD_COMMAND,
+                                 rtos::Kernel::Clock::duration_u32(
+                                   STEPPER_THREAD_IDLE_INTERVAL));
+        continue;
+      }
+
+      // from when the step was due, see Stepper::catchUp(), but from now
+      // after waiting for a target:
+      unsigned long now = micros();
+      deadline = idle ? now : Stepper::catchUp(deadline, now, interval);
+      idle = false;
+      deadline += interval;
+    }
+
+    long time_left = (long)(deadline - micros());
+    if (time_left > 0)
+    {
+      this->timeout.attach(mbed::callback(this, &StepperThread::wake),
+                           std::chrono::microseconds(time_left));
+      this->flags.wait_any(STEPPER_THREAD_STEP_DUE | STEPPER_THREAD_COMMAND);
+    }
+  }
+}
+
+#endif
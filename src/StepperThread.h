@@ -0,0 +1,112 @@
+/*
+ * StepperThread.h - Mbed OS motion thread for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * On Mbed OS boards (Portenta, Nano 33 BLE, Nano RP2040 Connect), runs
+ * one Stepper from a thread of its own, at a high priority, so that other
+ * threads neither starve while the motor turns nor upset its timing.
+ *
+ * The motion thread is the only one to touch the motor.  Other code sends
+ * it commands through a small lock-free queue, written by one thread (or
+ * interrupt handler) and read by the motion thread, so sending a command
+ * never blocks or waits on a mutex.  The thread sleeps between steps,
+ * woken by an mbed::Timeout at the time of the next step, or by a new
+ * command, and publishes the motor's position after each step.
+ *
+ * On other boards STEPPER_THREAD_SUPPORTED isn't defined and the class
+ * isn't available.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperThread_h
+#define StepperThread_h
+
+#include "Arduino.h"
+#include "Stepper.h"
+
+#if defined(ARDUINO_ARCH_MBED)
+#define STEPPER_THREAD_SUPPORTED
+#endif
+
+#ifdef STEPPER_THREAD_SUPPORTED
+
+#include "mbed.h"
+
+// how many commands can wait for the motion thread:
+#ifndef STEPPER_THREAD_QUEUE_SIZE
+#define STEPPER_THREAD_QUEUE_SIZE 8
+#endif
+
+// stack size of the motion thread, in bytes:
+#ifndef STEPPER_THREAD_STACK_SIZE
+#define STEPPER_THREAD_STACK_SIZE 1024
+#endif
+
+// library interface description
+class StepperThread {
+  public:
+    // constructor, for the motor the thread drives:
+    StepperThread(Stepper &motor, osPriority priority = osPriorityRealtime);
+
+    // starts the motion thread:
+    bool begin(void);
+
+    // commands; they return false, and are dropped, if the queue is full:
+    bool move(long steps_to_move);
+    bool moveTo(long absolute);
+    bool setMaxSpeed(long stepsPerSecond);
+    bool setAcceleration(long stepsPerSecondPerSecond);
+
+    // state of the motor, as of its last step:
+    long currentPosition(void);
+    bool isRunning(void);
+
+  private:
+    enum CommandType {
+      COMMAND_MOVE,
+      COMMAND_MOVE_TO,
+      COMMAND_MAX_SPEED,
+      COMMAND_ACCELERATION
+    };
+    struct Command {
+      uint8_t type;
+      long value;
+    };
+
+    bool send(uint8_t type, long value);
+    void applyCommands(void);
+    void wake(void);
+    void loop(void);
+
+    Stepper *motor;
+    rtos::Thread thread;
+    rtos::EventFlags flags;      // wakes the motion thread up
+    mbed::Timeout timeout;       // time of the next step
+
+    // commands, written at head by the sender, read at tail by the thread:
+    Command commands[STEPPER_THREAD_QUEUE_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+
+    // published by the motion thread:
+    volatile long position;
+    volatile bool running;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ * StepperTimer.cpp - Hardware timer step engine for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "StepperTimer.h"
+
+#ifdef STEPPER_TIMER_SUPPORTED
+
+// how often, in us, the interrupt checks for a new target while idle:
+#define STEPPER_TIMER_IDLE_INTERVAL 1000
+
+static Stepper *timer_motor = 0;    // the motor driven by the timer
+
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+
+/*
+ * On AVR and SAMD the timer is a 16 bit counter, reset on compare match.
+ * Delays longer than one counter period are split into several periods,
+ * the step being taken at the end of the last one.
+ */
+#define STEPPER_TIMER_MAX_TICKS 65535UL
+#define STEPPER_TIMER_MIN_TICKS 32UL  // leaves time to leave the interrupt
+
+static unsigned long timer_ticks_left = 0; // ticks to wait after this period
+
+static void timerSetPeriod(uint16_t ticks);
+
+/*
+ * Returns the compare value for a period of ticks from the last compare
+ * match, the counter having got to count since.  Working out the step
+ * takes a while at high step rates, and a compare value the counter has
+ * already passed would only match once it has wrapped round, 65536 ticks
+ * later; the next match then comes STEPPER_TIMER_MIN_TICKS from now.
+ */
+static uint16_t timerTop(unsigned long ticks, uint16_t count)
+{
+  unsigned long soon = (unsigned long)count + STEPPER_TIMER_MIN_TICKS;
+
+  if (ticks - 1 >= soon)
+    return ticks - 1;
+  return soon > STEPPER_TIMER_MAX_TICKS ? STEPPER_TIMER_MAX_TICKS : soon;
+}
+
+/*
+ * Loads the next counter period, keeping the remainder for later ones.
+ */
+static void timerLoadTicks(unsigned long ticks)
+{
+  unsigned long period;
+
+  if (ticks <= STEPPER_TIMER_MAX_TICKS)
+    period = ticks;
+  else if (ticks - STEPPER_TIMER_MAX_TICKS < STEPPER_TIMER_MIN_TICKS)
+    period = ticks >> 1;  // don't leave a remainder too short to reach
+  else
+    period = STEPPER_TIMER_MAX_TICKS;
+
+  timer_ticks_left = ticks - period;
+  timerSetPeriod(period);
+}
+
+#endif
+
+#if defined(__AVR__)
+
+// Timer1 counts at F_CPU / 8, i.e. 2 ticks per us at 16 MHz:
+#define STEPPER_TIMER_TICKS_PER_US (F_CPU / 8000000UL)
+
+static void timerSetPeriod(uint16_t ticks)
+{
+  OCR1A = timerTop(ticks, TCNT1);
+}
+
+static void timerLoad(unsigned long interval)
+{
+  unsigned long ticks = interval * STEPPER_TIMER_TICKS_PER_US;
+  if (ticks < STEPPER_TIMER_MIN_TICKS)
+    ticks = STEPPER_TIMER_MIN_TICKS;
+  timerLoadTicks(ticks);
+}
+
+static void timerStart(unsigned long interval)
+{
+  TCCR1A = 0;
+  TCCR1B = _BV(WGM12);          // CTC mode, TOP = OCR1A, timer stopped
+  TCNT1 = 0;
+  timerLoad(interval);
+  TIFR1 = _BV(OCF1A);           // clear any pending compare match
+  TIMSK1 |= _BV(OCIE1A);
+  TCCR1B = _BV(WGM12) | _BV(CS11); // start, prescaler 8
+}
+
+static void timerStop(void)
+{
+  TIMSK1 &= ~_BV(OCIE1A);
+  TCCR1B = 0;
+}
+
+ISR(TIMER1_COMPA_vect)
+{
+  StepperTimer::handleInterrupt();
+}
+
+#elif defined(ARDUINO_ARCH_SAMD)
+
+// TC3 counts at F_CPU / 16, i.e. 3 ticks per us at 48 MHz:
+#define STEPPER_TIMER_TICKS_PER_US (F_CPU / 16000000UL)
+
+static inline void timerSync(void)
+{
+  while (TC3->COUNT16.STATUS.bit.SYNCBUSY);
+}
+
+static uint16_t timerCount(void)
+{
+  TC3->COUNT16.READREQ.reg = TC_READREQ_RREQ | TC_READREQ_ADDR(0x10);
+  timerSync();
+  return TC3->COUNT16.COUNT.reg;
+}
+
+static void timerSetPeriod(uint16_t ticks)
+{
+  TC3->COUNT16.CC[0].reg = timerTop(ticks, timerCount());
+  timerSync();
+}
+
+static void timerLoad(unsigned long interval)
+{
+  unsigned long ticks = interval * STEPPER_TIMER_TICKS_PER_US;
+  if (ticks < STEPPER_TIMER_MIN_TICKS)
+    ticks = STEPPER_TIMER_MIN_TICKS;
+  timerLoadTicks(ticks);
+}
+
+static void timerStart(unsigned long interval)
+{
+  // feed TC3 from the 48 MHz generic clock 0:
+  GCLK->CLKCTRL.reg = (uint16_t)(GCLK_CLKCTRL_CLKEN | GCLK_CLKCTRL_GEN_GCLK0 |
+                                 GCLK_CLKCTRL_ID_TCC2_TC3);
+  while (GCLK->STATUS.bit.SYNCBUSY);
+
+  TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+  timerSync();
+  // 16 bit counter, reset on CC0 match, prescaler 16:
+  TC3->COUNT16.CTRLA.reg = TC_CTRLA_MODE_COUNT16 | TC_CTRLA_WAVEGEN_MFRQ |
+                           TC_CTRLA_PRESCALER_DIV16;
+  timerSync();
+  TC3->COUNT16.COUNT.reg = 0;
+  timerSync();
+  timerLoad(interval);
+
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  TC3->COUNT16.INTENSET.reg = TC_INTENSET_MC0;
+  NVIC_EnableIRQ(TC3_IRQn);
+
+  TC3->COUNT16.CTRLA.reg |= TC_CTRLA_ENABLE;
+  timerSync();
+}
+
+static void timerStop(void)
+{
+  TC3->COUNT16.INTENCLR.reg = TC_INTENCLR_MC0;
+  TC3->COUNT16.CTRLA.reg &= ~TC_CTRLA_ENABLE;
+  timerSync();
+  NVIC_DisableIRQ(TC3_IRQn);
+}
+
+void TC3_Handler(void)
+{
+  TC3->COUNT16.INTFLAG.reg = TC_INTFLAG_MC0;
+  StepperTimer::handleInterrupt();
+}
+
+#elif defined(ARDUINO_ARCH_MBED)
+
+#include "mbed.h"
+
+// mbed::Timeout counts in us and handles long delays by itself:
+static mbed::Timeout timer_timeout;
+
+static void timerLoad(unsigned long interval)
+{
+  timer_timeout.attach(&StepperTimer::handleInterrupt,
+                       std::chrono::microseconds(interval));
+}
+
+static void timerStart(unsigned long interval)
+{
+  timerLoad(interval);
+}
+
+static void timerStop(void)
+{
+  timer_timeout.detach();
+}
+
+#endif
+
+/*
+ * Starts driving the motor from the timer interrupt.  From now on,
+ * use StepperTimer::move() and moveTo() instead of the motor's own
+ * mover methods.
+ */
+void StepperTimer::begin(Stepper &motor)
+{
+  end();
+  timer_motor = &motor;
+  timerStart(STEPPER_TIMER_IDLE_INTERVAL);
+}
+
+/*
+ * Stops the timer interrupt.  The motor keeps its target, so a move
+ * that was in progress can be finished with run() or step().
+ */
+void StepperTimer::end(void)
+{
+  if (timer_motor == 0)
+    return;
+
+  timerStop();
+  timer_motor = 0;
+}
+
+/*
+ * Sets a new target position steps_to_move steps away from the current
+ * position.
+ */
+void StepperTimer::move(long steps_to_move)
+{
+  if (timer_motor == 0)
+    return;
+
+  noInterrupts();
+  timer_motor->move(steps_to_move);
+  interrupts();
+}
+
+/*
+ * Sets a new absolute target position.
+ */
+void StepperTimer::moveTo(long absolute)
+{
+  if (timer_motor == 0)
+    return;
+
+  noInterrupts();
+  timer_motor->moveTo(absolute);
+  interrupts();
+}
+
+/*
+ * Returns true while the motor still has steps left to take.
+ */
+bool StepperTimer::isRunning(void)
+{
+  if (timer_motor == 0)
+    return false;
+
+  noInterrupts();
+  bool running = timer_motor->current_position != timer_motor->target_position;
+  interrupts();
+  return running;
+}
+
+/*
+ * Takes the step that is due and loads the delay before the next one.
+ */
+void StepperTimer::handleInterrupt(void)
+{
+#if defined(__AVR__) || defined(ARDUINO_ARCH_SAMD)
+  // still in the middle of a long delay:
+  if (timer_ticks_left > 0)
+  {
+    timerLoadTicks(timer_ticks_left);
+    return;
+  }
+#endif
+
+  unsigned long interval = timer_motor->nextStep();
+  if (interval == 0)
+    interval = STEPPER_TIMER_IDLE_INTERVAL;
+  timerLoad(interval);
+}
+
+#endif
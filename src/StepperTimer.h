@@ -0,0 +1,66 @@
+/*
+ * StepperTimer.h - Hardware timer step engine for the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Drives one Stepper from a hardware timer interrupt instead of from
+ * loop().  Each interrupt takes one step and loads the timer compare value
+ * with the delay before the next one, so pulse timing doesn't depend on
+ * what the sketch is doing.  The timer used depends on the board:
+ *
+ *   AVR (Uno, Nano, Mega, Leonardo)        Timer1, compare match A
+ *   SAMD21 (Zero, MKR, Nano 33 IoT)        TC3, match/compare 0
+ *   Mbed OS (Portenta, Nano 33 BLE, RP2040) mbed::Timeout
+ *
+ * Timer1 is also used by the Servo library on AVR, so the two can't be
+ * used together there.  On other boards STEPPER_TIMER_SUPPORTED isn't
+ * defined and the class isn't available.
+ */
+
+// ensure this library description is only included once
+#ifndef StepperTimer_h
+#define StepperTimer_h
+
+#include "Arduino.h"
+#include "Stepper.h"
+
+#if (defined(__AVR__) && defined(OCR1A)) || \
+    (defined(ARDUINO_ARCH_SAMD) && !defined(__SAMD51__)) || \
+    defined(ARDUINO_ARCH_MBED)
+#define STEPPER_TIMER_SUPPORTED
+#endif
+
+#ifdef STEPPER_TIMER_SUPPORTED
+
+// library interface description
+class StepperTimer {
+  public:
+    // starts and stops driving a motor from the timer interrupt:
+    static void begin(Stepper &motor);
+    static void end(void);
+
+    // mover methods, safe to call while the timer is running:
+    static void move(long steps_to_move);
+    static void moveTo(long absolute);
+    static bool isRunning(void);
+
+    // called from the timer interrupt:
+    static void handleInterrupt(void);
+};
+
+#endif
+
+#endif
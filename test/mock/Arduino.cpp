@@ -0,0 +1,180 @@
+/*
+ * Arduino.cpp - Mock Arduino core for host builds of the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#include "Arduino.h"
+
+static unsigned long mock_time;                 // the simulated time, in us
+static uint8_t pin_levels[MOCK_PIN_COUNT];
+static uint8_t pin_modes[MOCK_PIN_COUNT];
+static int analog_values[MOCK_PIN_COUNT];
+static MockPinWrite trace[MOCK_TRACE_SIZE];
+static unsigned int trace_length;
+
+// interrupts, attached to pins, as every pin can interrupt here:
+static void (*handlers[MOCK_PIN_COUNT])(void);
+static int handler_modes[MOCK_PIN_COUNT];
+static bool interrupts_on = true;
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+  if (pin < MOCK_PIN_COUNT)
+    pin_modes[pin] = mode;
+  if (mode == INPUT_PULLUP)
+    mockSetPin(pin, HIGH);
+}
+
+void digitalWrite(uint8_t pin, uint8_t level)
+{
+  if (pin >= MOCK_PIN_COUNT)
+    return;
+  pin_levels[pin] = level ? HIGH : LOW;
+  if (trace_length < MOCK_TRACE_SIZE)
+  {
+    trace[trace_length].time = mock_time;
+    trace[trace_length].pin = pin;
+    trace[trace_length].level = pin_levels[pin];
+    trace_length++;
+  }
+}
+
+int digitalRead(uint8_t pin)
+{
+  return pin < MOCK_PIN_COUNT ? pin_levels[pin] : LOW;
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+  if (pin < MOCK_PIN_COUNT)
+    analog_values[pin] = value;
+}
+
+unsigned long micros(void)
+{
+  return mock_time;
+}
+
+unsigned long millis(void)
+{
+  return mock_time / 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+  mock_time += us;
+}
+
+void yield(void)
+{
+  mock_time += MOCK_YIELD_TIME;
+}
+
+void noInterrupts(void)
+{
+  interrupts_on = false;
+}
+
+void interrupts(void)
+{
+  interrupts_on = true;
+}
+
+int digitalPinToInterrupt(uint8_t pin)
+{
+  return pin < MOCK_PIN_COUNT ? pin : NOT_AN_INTERRUPT;
+}
+
+void attachInterrupt(int interrupt, void (*handler)(void), int mode)
+{
+  handlers[interrupt] = handler;
+  handler_modes[interrupt] = mode;
+}
+
+void detachInterrupt(int interrupt)
+{
+  handlers[interrupt] = 0;
+}
+
+/*
+ * Sets the simulation back to its start: time 0, all pins low and
+ * inputs, nothing recorded and no interrupts attached.
+ */
+void mockReset(void)
+{
+  mock_time = 0;
+  memset(pin_levels, 0, sizeof(pin_levels));
+  memset(pin_modes, 0, sizeof(pin_modes));
+  memset(analog_values, 0, sizeof(analog_values));
+  memset(handlers, 0, sizeof(handlers));
+  interrupts_on = true;
+  trace_length = 0;
+}
+
+void mockSetMicros(unsigned long time)
+{
+  mock_time = time;
+}
+
+void mockAdvanceMicros(unsigned long us)
+{
+  mock_time += us;
+}
+
+/*
+ * Drives an input pin from outside, as a switch would, calling the pin's
+ * interrupt handler, if it has one and interrupts are on, on the edges it
+ * was attached for.
+ */
+void mockSetPin(uint8_t pin, uint8_t level)
+{
+  if (pin >= MOCK_PIN_COUNT)
+    return;
+  uint8_t previous = pin_levels[pin];
+  pin_levels[pin] = level ? HIGH : LOW;
+
+  if (handlers[pin] == 0 || !interrupts_on || previous == pin_levels[pin])
+    return;
+  int mode = handler_modes[pin];
+  if (mode == CHANGE || (mode == RISING && pin_levels[pin] == HIGH) ||
+      (mode == FALLING && pin_levels[pin] == LOW))
+    handlers[pin]();
+}
+
+int mockPinMode(uint8_t pin)
+{
+  return pin < MOCK_PIN_COUNT ? pin_modes[pin] : INPUT;
+}
+
+int mockAnalogValue(uint8_t pin)
+{
+  return pin < MOCK_PIN_COUNT ? analog_values[pin] : 0;
+}
+
+unsigned int mockTraceLength(void)
+{
+  return trace_length;
+}
+
+const MockPinWrite *mockTrace(void)
+{
+  return trace;
+}
+
+void mockClearTrace(void)
+{
+  trace_length = 0;
+}
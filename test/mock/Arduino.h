@@ -0,0 +1,94 @@
+/*
+ * Arduino.h - Mock Arduino core for host builds of the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Provides the parts of the Arduino core the library uses, on a PC.  Time
+ * only passes when a test sets it, or when the library waits with yield()
+ * or delayMicroseconds(), and every digitalWrite() is recorded with the
+ * time it was made, so that tests can check both the pin sequences and
+ * the step timing exactly.
+ */
+
+// ensure this mock is only included once
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE  1
+#define FALLING 2
+#define RISING  3
+
+#define NOT_AN_INTERRUPT -1
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+
+// how many pins, and how many pin writes the trace keeps:
+#define MOCK_PIN_COUNT   64
+#define MOCK_TRACE_SIZE  8192
+
+// how long yield() takes, in us:
+#define MOCK_YIELD_TIME  1
+
+// a recorded digitalWrite():
+struct MockPinWrite {
+  unsigned long time;         // when it was made, in us
+  uint8_t pin;
+  uint8_t level;              // HIGH or LOW
+};
+
+// the core functions the library uses:
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t level);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+unsigned long micros(void);
+unsigned long millis(void);
+void delayMicroseconds(unsigned int us);
+void yield(void);
+void noInterrupts(void);
+void interrupts(void);
+int digitalPinToInterrupt(uint8_t pin);
+void attachInterrupt(int interrupt, void (*handler)(void), int mode);
+void detachInterrupt(int interrupt);
+
+// control of the simulation, for the tests:
+void mockReset(void);
+void mockSetMicros(unsigned long time);
+void mockAdvanceMicros(unsigned long us);
+void mockSetPin(uint8_t pin, uint8_t level);
+int mockPinMode(uint8_t pin);
+int mockAnalogValue(uint8_t pin);
+unsigned int mockTraceLength(void);
+const MockPinWrite *mockTrace(void);
+void mockClearTrace(void);
+
+#endif
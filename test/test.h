@@ -0,0 +1,108 @@
+/*
+ * test.h - Checks for the host tests of the Stepper library
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Each test program runs its tests with RUN_TEST() and ends with
+ * testResult(); a failed CHECK() prints where it failed and carries on,
+ * so one run shows every failure.
+ */
+
+// ensure this file is only included once
+#ifndef test_h
+#define test_h
+
+#include <stdio.h>
+#include "Arduino.h"
+
+static int checks_failed = 0;
+
+#define CHECK(condition) \
+  checkThat((condition), #condition, __FILE__, __LINE__)
+
+#define CHECK_EQUAL(expected, actual) \
+  checkEqual((long)(expected), (long)(actual), #actual, __FILE__, __LINE__)
+
+#define RUN_TEST(test) \
+  do { mockReset(); printf("  %s\n", #test); test(); } while (0)
+
+static inline bool checkThat(bool passed, const char *condition,
+                             const char *file, int line)
+{
+  if (!passed)
+  {
+    printf("%s:%d: FAILED: %s\n", file, line, condition);
+    checks_failed++;
+  }
+  return passed;
+}
+
+static inline bool checkEqual(long expected, long actual, const char *what,
+                              const char *file, int line)
+{
+  if (expected != actual)
+  {
+    printf("%s:%d: FAILED: %s is %ld, expected %ld\n",
+           file, line, what, actual, expected);
+    checks_failed++;
+  }
+  return expected == actual;
+}
+
+/*
+ * Prints whether the tests passed, and returns the program's exit status.
+ */
+static inline int testResult(void)
+{
+  if (checks_failed != 0)
+    printf("%d checks FAILED\n", checks_failed);
+  else
+    printf("OK\n");
+  return checks_failed != 0;
+}
+
+/*
+ * Returns the levels of the given pins, in order, as a string of 0s and
+ * 1s like the tables in Stepper.h, in a buffer of at least count + 1.
+ */
+static inline const char *pinLevels(const uint8_t pins[], uint8_t count,
+                                    char *levels)
+{
+  for (uint8_t i = 0; i < count; i++)
+    levels[i] = digitalRead(pins[i]) ? '1' : '0';
+  levels[count] = '\0';
+  return levels;
+}
+
+/*
+ * Collects the times of the pin writes recorded since the trace was last
+ * cleared, once for each time at which any pin was written, i.e. once per
+ * step of a coil motor.  Returns how many there are.
+ */
+static inline unsigned int writeTimes(unsigned long times[], unsigned int size)
+{
+  const MockPinWrite *trace = mockTrace();
+  unsigned int count = 0;
+
+  for (unsigned int i = 0; i < mockTraceLength() && count < size; i++)
+  {
+    if (count == 0 || trace[i].time != times[count - 1])
+      times[count++] = trace[i].time;
+  }
+  return count;
+}
+
+#endif
@@ -0,0 +1,205 @@
+/*
+ * test_group.cpp - Coordinated moves of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Moves groups of motors with StepperGroup, and checks that they keep to
+ * the straight line between start and target, at the lead motor's pace,
+ * and arrive together.
+ */
+
+#include "Arduino.h"
+#include "Stepper.h"
+#include "StepperGroup.h"
+#include "test.h"
+
+/*
+ * Runs the group with run() until the move is done, with time passing
+ * 1 us per call.  At each tick, checks that every motor is within half a
+ * step of the line from where it started to the target, i.e. that its
+ * position times the lead motor's distance is that of the lead motor
+ * times its own, to within half the lead motor's distance.  Returns the
+ * number of ticks.
+ */
+static long runOnLine(StepperGroup &group, Stepper *motors[],
+                      const long distance[], uint8_t count)
+{
+  long start[STEPPER_GROUP_MAX_MOTORS];
+  uint8_t lead = 0;
+  for (uint8_t i = 0; i < count; i++)
+  {
+    start[i] = motors[i]->currentPosition();
+    if (labs(distance[i]) > labs(distance[lead]))
+      lead = i;
+  }
+
+  long ticks = 0;
+  long lead_done = 0;
+  while (group.run())
+  {
+    long done = labs(motors[lead]->currentPosition() - start[lead]);
+    if (done != lead_done)
+    {
+      ticks++;
+      lead_done = done;
+      for (uint8_t i = 0; i < count; i++)
+      {
+        long moved = motors[i]->currentPosition() - start[i];
+        long off = moved * labs(distance[lead]) - distance[i] * done;
+        if (!CHECK(2 * labs(off) <= labs(distance[lead])))
+          printf("    motor %u at %ld after %ld lead steps\n", i, moved, done);
+      }
+    }
+    mockAdvanceMicros(1);
+  }
+  return ticks + 1;
+}
+
+/*
+ * 200 steps against 100: the second motor steps every other tick, and
+ * both get there on the lead motor's last step.
+ */
+static void testLine(void)
+{
+  Stepper x(200, 8, 9, 10, 11);
+  Stepper y(200, 4, 5, 6, 7);
+  Stepper *motors[2] = { &x, &y };
+  const long target[2] = { 200, 100 };
+  StepperGroup group;
+
+  CHECK(group.addStepper(x));
+  CHECK(group.addStepper(y));
+  x.setStepInterval(1000);
+  group.moveTo(target);
+  mockSetMicros(1000000);
+  CHECK_EQUAL(200, runOnLine(group, motors, target, 2));
+  CHECK_EQUAL(200, x.currentPosition());
+  CHECK_EQUAL(100, y.currentPosition());
+  CHECK(!group.run());
+}
+
+/*
+ * The ticks come at the lead motor's speed, whichever motor was added
+ * first and whatever the others' speeds: 40 steps at 2000 us, 78 ms in
+ * all from the first tick to the last.
+ */
+static void testLeadSetsPace(void)
+{
+  Stepper fast(200, 8, 9, 10, 11);
+  Stepper slow(200, 4, 5, 6, 7);
+  const long target[2] = { 10, 40 };
+  StepperGroup group;
+
+  group.addStepper(fast);
+  group.addStepper(slow);
+  fast.setStepInterval(500);
+  slow.setStepInterval(2000);
+  group.moveTo(target);
+
+  mockSetMicros(1000000);
+  mockClearTrace();
+  while (group.run())
+    mockAdvanceMicros(1);
+  unsigned long times[64];
+  unsigned int ticks = writeTimes(times, 64);
+  CHECK_EQUAL(40, ticks);
+  for (unsigned int i = 1; i < ticks; i++)
+    CHECK_EQUAL(2000, times[i] - times[i - 1]);
+  CHECK_EQUAL(10, fast.currentPosition());
+  CHECK_EQUAL(40, slow.currentPosition());
+}
+
+/*
+ * Three motors, one of them going back and one staying where it is, from
+ * positions other than 0: the line is between where they start and the
+ * targets, and the one not moving writes no pins.
+ */
+static void testMixedDirections(void)
+{
+  Stepper x(200, 8, 9, 10, 11);
+  Stepper y(200, 4, 5, 6, 7);
+  Stepper z(200, 20, 21, 22, 23);
+  Stepper *motors[3] = { &x, &y, &z };
+  const long target[3] = { 350, -170, 25 };
+  const long distance[3] = { 300, -150, 0 };
+  StepperGroup group;
+
+  x.setCurrentPosition(50);
+  y.setCurrentPosition(-20);
+  z.setCurrentPosition(25);
+  group.addStepper(x);
+  group.addStepper(y);
+  group.addStepper(z);
+  x.setStepInterval(100);
+  group.moveTo(target);
+  mockClearTrace();
+  CHECK_EQUAL(300, runOnLine(group, motors, distance, 3));
+  CHECK_EQUAL(350, x.currentPosition());
+  CHECK_EQUAL(-170, y.currentPosition());
+  CHECK_EQUAL(25, z.currentPosition());
+  for (unsigned int i = 0; i < mockTraceLength(); i++)
+    CHECK(mockTrace()[i].pin < 20);
+}
+
+/*
+ * A group holds STEPPER_GROUP_MAX_MOTORS motors, no more, and moving to
+ * where the motors are already is done at once.
+ */
+static void testFull(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  const long target[STEPPER_GROUP_MAX_MOTORS] = { 0 };
+  StepperGroup group;
+
+  for (uint8_t i = 0; i < STEPPER_GROUP_MAX_MOTORS; i++)
+    CHECK(group.addStepper(motor));
+  CHECK(!group.addStepper(motor));
+
+  group.moveTo(target);
+  mockClearTrace();
+  CHECK(!group.run());
+  CHECK_EQUAL(0, mockTraceLength());
+}
+
+/*
+ * runToPosition() blocks until all motors are there.
+ */
+static void testRunToPosition(void)
+{
+  Stepper x(200, 8, 9, 10, 11);
+  Stepper y(200, 4, 5, 6, 7);
+  const long target[2] = { -30, 45 };
+  StepperGroup group;
+
+  group.addStepper(x);
+  group.addStepper(y);
+  y.setStepInterval(200);
+  group.moveTo(target);
+  group.runToPosition();
+  CHECK_EQUAL(-30, x.currentPosition());
+  CHECK_EQUAL(45, y.currentPosition());
+}
+
+int main(void)
+{
+  printf("test_group\n");
+  RUN_TEST(testLine);
+  RUN_TEST(testLeadSetsPace);
+  RUN_TEST(testMixedDirections);
+  RUN_TEST(testFull);
+  RUN_TEST(testRunToPosition);
+  return testResult();
+}
@@ -0,0 +1,298 @@
+/*
+ * test_limit_switch.cpp - Limit switches of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Presses a switch on a mock interrupt pin part way through a move, and
+ * checks that the interrupt leaves the motor to stop itself.
+ */
+
+#include "Arduino.h"
+#include "Stepper.h"
+#include "StepperGroup.h"
+#include "StepperLimitSwitch.h"
+#include "StepperProfile.h"
+#include "StepperQueue.h"
+#include "test.h"
+
+#define SWITCH_PIN 2
+
+/*
+ * Runs the motor with run() until it gets to the given position, with
+ * time passing 1 us per call.
+ */
+static void runTo(Stepper &motor, long position)
+{
+  while (motor.currentPosition() != position && motor.run())
+    mockAdvanceMicros(1);
+}
+
+/*
+ * The interrupt only flags the motor: its target is still there until
+ * run() stops it, without another step, where the switch was pressed.
+ */
+static void testStopsBeforeNextStep(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+
+  CHECK(limit.begin());
+  motor.setStepInterval(1000);
+  motor.move(200);
+  runTo(motor, 100);
+
+  mockSetPin(SWITCH_PIN, LOW);
+  CHECK_EQUAL(100, motor.distanceToGo());
+
+  mockClearTrace();
+  mockAdvanceMicros(1000);
+  CHECK(!motor.run());
+  CHECK_EQUAL(0, mockTraceLength());
+  CHECK_EQUAL(100, motor.currentPosition());
+  CHECK_EQUAL(0, motor.distanceToGo());
+  CHECK(limit.triggered());
+  CHECK_EQUAL(100, limit.triggerPosition());
+  limit.end();
+}
+
+/*
+ * Until clear(), the switch doesn't stop the motor again, so it can be
+ * moved off the switch; the position it stopped at is kept meanwhile.
+ */
+static void testClear(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+
+  limit.begin();
+  motor.setStepInterval(1000);
+  motor.move(50);
+  runTo(motor, 20);
+  mockSetPin(SWITCH_PIN, LOW);
+  motor.run();
+  CHECK_EQUAL(20, limit.triggerPosition());
+
+  // bouncing while it backs off:
+  motor.move(-10);
+  mockSetPin(SWITCH_PIN, HIGH);
+  runTo(motor, 15);
+  mockSetPin(SWITCH_PIN, LOW);
+  mockSetPin(SWITCH_PIN, HIGH);
+  runTo(motor, 10);
+  CHECK_EQUAL(10, motor.currentPosition());
+  CHECK_EQUAL(20, limit.triggerPosition());
+
+  limit.clear();
+  CHECK(!limit.triggered());
+  motor.move(10);
+  runTo(motor, 14);
+  mockSetPin(SWITCH_PIN, LOW);
+  motor.run();
+  CHECK_EQUAL(14, motor.currentPosition());
+  CHECK_EQUAL(14, limit.triggerPosition());
+  limit.end();
+}
+
+/*
+ * runSpeed() has no target, but stops all the same.
+ */
+static void testStopsRunSpeed(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, HIGH);
+
+  limit.begin();
+  motor.setSpeedStepsPerSecond(-1000);
+  while (motor.currentPosition() > -30)
+  {
+    motor.runSpeed();
+    mockAdvanceMicros(1);
+  }
+  mockSetPin(SWITCH_PIN, HIGH);
+  mockAdvanceMicros(10000);
+  CHECK(!motor.runSpeed());
+  CHECK_EQUAL(-30, motor.currentPosition());
+  CHECK_EQUAL(-30, limit.triggerPosition());
+  limit.end();
+}
+
+/*
+ * A switch on one motor of a group ends the whole move, so the other
+ * motor doesn't go on along the line alone.
+ */
+static void testStopsGroup(void)
+{
+  Stepper x(200, 8, 9, 10, 11);
+  Stepper y(200, 4, 5, 6, 7);
+  StepperLimitSwitch limit(y, SWITCH_PIN, LOW);
+  StepperGroup group;
+  const long target[2] = { 200, 100 };
+
+  limit.begin();
+  x.setStepInterval(1000);
+  group.addStepper(x);
+  group.addStepper(y);
+  group.moveTo(target);
+  while (x.currentPosition() < 50)
+  {
+    group.run();
+    mockAdvanceMicros(1);
+  }
+  mockSetPin(SWITCH_PIN, LOW);
+  mockAdvanceMicros(1000);
+  CHECK(!group.run());
+  CHECK_EQUAL(50, x.currentPosition());
+  CHECK_EQUAL(25, y.currentPosition());
+  CHECK_EQUAL(0, x.distanceToGo());
+  CHECK_EQUAL(0, y.distanceToGo());
+  CHECK_EQUAL(25, limit.triggerPosition());
+  limit.end();
+}
+
+/*
+ * A switch ends the move of a profile too.
+ */
+static void testStopsProfile(void)
+{
+  static int16_t entries[64];
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+  StepperProfile profile(entries, 64);
+
+  limit.begin();
+  motor.setMaxSpeed(1000);
+  motor.setAcceleration(100000);
+  CHECK(profile.compile(motor, 2000));
+  profile.play(motor);
+  while (motor.currentPosition() < 50)
+  {
+    profile.run();
+    mockAdvanceMicros(1);
+  }
+  mockSetPin(SWITCH_PIN, LOW);
+  mockAdvanceMicros(10000);
+  CHECK(!profile.run());
+  CHECK_EQUAL(50, motor.currentPosition());
+  CHECK_EQUAL(0, motor.distanceToGo());
+  limit.end();
+}
+
+/*
+ * A switch ends the running segment of a queue and drops the others, so
+ * that the motor doesn't go on from where it stopped.
+ */
+static void testStopsQueue(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+  StepperQueue queue(motor);
+
+  limit.begin();
+  queue.push(100, 1000);
+  queue.push(100, 1000);
+  while (motor.currentPosition() < 50)
+  {
+    queue.run();
+    mockAdvanceMicros(1);
+  }
+  mockSetPin(SWITCH_PIN, LOW);
+  for (unsigned int i = 0; i < 100000 && queue.run(); i++)
+    mockAdvanceMicros(1);
+  CHECK(!queue.run());
+  CHECK_EQUAL(0, queue.size());
+  CHECK_EQUAL(50, motor.currentPosition());
+  limit.end();
+}
+
+/*
+ * clear() drops a stop the motor hasn't acted on, e.g. as nothing was
+ * running it when the switch was pressed, so the next move goes ahead.
+ */
+static void testClearPendingStop(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+
+  limit.begin();
+  motor.setStepInterval(1000);
+  mockSetPin(SWITCH_PIN, LOW);
+  mockSetPin(SWITCH_PIN, HIGH);
+  CHECK(limit.triggered());
+  limit.clear();
+
+  motor.move(100);
+  runTo(motor, 100);
+  CHECK_EQUAL(100, motor.currentPosition());
+  limit.end();
+}
+
+/*
+ * A stop at full speed leaves the ramp at rest: the next move's first
+ * step comes the first ramp delay after the last one, not at full speed.
+ */
+static void testStopResetsRamp(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+
+  limit.begin();
+  motor.setMaxSpeed(2000);
+  motor.setAcceleration(1000);
+  motor.move(100000);
+  runTo(motor, 3000);
+  unsigned long last_step = micros() - 1;
+  mockSetPin(SWITCH_PIN, LOW);
+  CHECK(!motor.run());
+
+  motor.move(-10);
+  mockClearTrace();
+  while (motor.run())
+    mockAdvanceMicros(1);
+  // the first ramp delay, 0.676 * sqrt(2 / a), about 30 ms:
+  long delay = mockTrace()[0].time - last_step;
+  CHECK(delay > 29000 && delay < 31000);
+  limit.end();
+}
+
+/*
+ * Without begin(), homing() can't be stopped by the switch, so it fails
+ * without moving the motor.
+ */
+static void testHomingWithoutBegin(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperLimitSwitch limit(motor, SWITCH_PIN, LOW);
+
+  mockClearTrace();
+  CHECK(!limit.homing(-1000, 1000, 100));
+  CHECK_EQUAL(0, mockTraceLength());
+  CHECK_EQUAL(0, motor.currentPosition());
+}
+
+int main(void)
+{
+  printf("test_limit_switch\n");
+  RUN_TEST(testStopsBeforeNextStep);
+  RUN_TEST(testClear);
+  RUN_TEST(testStopsRunSpeed);
+  RUN_TEST(testStopsGroup);
+  RUN_TEST(testStopsProfile);
+  RUN_TEST(testStopsQueue);
+  RUN_TEST(testClearPendingStop);
+  RUN_TEST(testStopResetsRamp);
+  RUN_TEST(testHomingWithoutBegin);
+  return testResult();
+}
@@ -0,0 +1,190 @@
+/*
+ * test_profile.cpp - Precomputed moves of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Compiles moves with StepperProfile and plays them, and checks from the
+ * pin trace that they ramp as the motor's own run() does, and that every
+ * play of a move takes exactly as long as the last.
+ */
+
+#include "Arduino.h"
+#include "Stepper.h"
+#include "StepperProfile.h"
+#include "test.h"
+
+#define MAX_STEPS 2000
+
+static int16_t entries[512];
+static unsigned long expected[MAX_STEPS];
+static unsigned long times[MAX_STEPS];
+
+/*
+ * Plays the profile until it's done, with time passing 1 us per call,
+ * and returns how many steps were taken, their times counted from the
+ * first one.
+ */
+static unsigned int playTimes(StepperProfile &profile, Stepper &motor,
+                              bool reverse, unsigned long times[])
+{
+  mockSetMicros(1000000);
+  mockClearTrace();
+  if (reverse)
+    profile.playReverse(motor);
+  else
+    profile.play(motor);
+  while (profile.run() && micros() < 100000000UL)
+    mockAdvanceMicros(1);
+  unsigned int steps = writeTimes(times, MAX_STEPS);
+  for (unsigned int i = steps; i > 0; i--)
+    times[i - 1] -= times[0];
+  return steps;
+}
+
+/*
+ * The same move with run(), for comparison.
+ */
+static unsigned int runTimes(Stepper &motor, long steps,
+                             unsigned long times[])
+{
+  mockSetMicros(1000000);
+  mockClearTrace();
+  motor.move(steps);
+  while (motor.run() && micros() < 100000000UL)
+    mockAdvanceMicros(1);
+  unsigned int count = writeTimes(times, MAX_STEPS);
+  for (unsigned int i = count; i > 0; i--)
+    times[i - 1] -= times[0];
+  return count;
+}
+
+/*
+ * A move that gets to full speed: the same steps as run() takes, each
+ * within a few us of run()'s up to full speed and at it, and the motor
+ * where run() leaves it.  run() works its ramp down out afresh, whose
+ * delays come out a little different from the ramp up played backwards,
+ * by a few ms in all.
+ */
+static void testMatchesRun(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperProfile profile(entries, 512);
+
+  motor.setMaxSpeed(2000);
+  motor.setAcceleration(8000);
+  CHECK_EQUAL(1500, runTimes(motor, 1500, expected));
+  CHECK_EQUAL(1500, motor.currentPosition());
+
+  CHECK(profile.compile(motor, -1500));
+  CHECK_EQUAL(1500, playTimes(profile, motor, false, times));
+  CHECK_EQUAL(0, motor.currentPosition());
+  CHECK_EQUAL(0, motor.distanceToGo());
+  for (unsigned int i = 0; i < 1500; i++)
+  {
+    long error = (long)(times[i] - expected[i]);
+    long tolerance = i < 1200 ? 20 : expected[i] / 200;
+    if (!CHECK(labs(error) <= tolerance))
+    {
+      printf("    step %u at %lu us, run() at %lu\n", i, times[i], expected[i]);
+      break;
+    }
+  }
+}
+
+/*
+ * Each play of the move takes exactly as long as the last, and played
+ * backwards it comes back to where it started, on the same ramp.
+ */
+static void testRepeats(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperProfile profile(entries, 512);
+
+  motor.setMaxSpeed(1000);
+  motor.setAcceleration(4000);
+  CHECK(profile.compile(motor, 600));
+
+  CHECK_EQUAL(600, playTimes(profile, motor, false, expected));
+  CHECK_EQUAL(600, motor.currentPosition());
+  CHECK_EQUAL(600, playTimes(profile, motor, true, times));
+  CHECK_EQUAL(0, motor.currentPosition());
+  for (unsigned int i = 0; i < 600; i++)
+    CHECK_EQUAL(expected[i], times[i]);
+  CHECK_EQUAL(600, playTimes(profile, motor, false, times));
+  for (unsigned int i = 0; i < 600; i++)
+    CHECK_EQUAL(expected[i], times[i]);
+}
+
+/*
+ * A move too short to get to full speed peaks half way, and slows down
+ * on the same ramp backwards.
+ */
+static void testShortMove(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperProfile profile(entries, 512);
+
+  motor.setMaxSpeed(5000);
+  motor.setAcceleration(1000);
+  CHECK(profile.compile(motor, 101));
+  CHECK_EQUAL(101, playTimes(profile, motor, false, times));
+  for (unsigned int i = 1; i < 50; i++)
+  {
+    // the delays after step i and before step 101 - i match:
+    CHECK_EQUAL(times[i] - times[i - 1], times[101 - i] - times[100 - i]);
+    CHECK(times[i + 1] - times[i] <= times[i] - times[i - 1]);
+  }
+}
+
+/*
+ * Without an acceleration, the move is at the motor's speed throughout,
+ * and needs no entries.
+ */
+static void testNoRamp(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperProfile profile(entries, 0);
+
+  motor.setStepInterval(750);
+  CHECK(profile.compile(motor, 20));
+  CHECK_EQUAL(20, playTimes(profile, motor, false, times));
+  for (unsigned int i = 1; i < 20; i++)
+    CHECK_EQUAL(750, times[i] - times[i - 1]);
+}
+
+/*
+ * A ramp longer than the entries there are fails to compile.
+ */
+static void testTooLong(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperProfile profile(entries, 16);
+
+  motor.setMaxSpeed(2000);
+  motor.setAcceleration(8000);
+  CHECK(!profile.compile(motor, 1500));
+}
+
+int main(void)
+{
+  printf("test_profile\n");
+  RUN_TEST(testMatchesRun);
+  RUN_TEST(testRepeats);
+  RUN_TEST(testShortMove);
+  RUN_TEST(testNoRamp);
+  RUN_TEST(testTooLong);
+  return testResult();
+}
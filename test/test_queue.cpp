@@ -0,0 +1,167 @@
+/*
+ * test_queue.cpp - Queued moves of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Runs segments through StepperQueue, and checks from the pin trace
+ * that they follow each other at their own speeds, and that with an
+ * acceleration the motor passes the junctions without stopping.
+ */
+
+#include "Arduino.h"
+#include "Stepper.h"
+#include "StepperQueue.h"
+#include "test.h"
+
+#define MAX_STEPS 2000
+
+static unsigned long times[MAX_STEPS];
+
+/*
+ * Runs the queue until it's empty, with time passing 1 us per call, and
+ * returns how many steps were taken, their times in times[].
+ */
+static unsigned int runQueue(StepperQueue &queue)
+{
+  mockSetMicros(1000000);
+  mockClearTrace();
+  while (queue.run() && micros() < 100000000UL)
+    mockAdvanceMicros(1);
+  return writeTimes(times, MAX_STEPS);
+}
+
+/*
+ * Without acceleration, each segment runs at its own step delay from
+ * its first step on, and the next one starts right after it.
+ */
+static void testBackToBack(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperQueue queue(motor);
+
+  CHECK(queue.push(50, 1000));
+  CHECK(queue.push(-20, 2000));
+  CHECK(queue.push(30, 500));
+  CHECK_EQUAL(3, queue.size());
+
+  CHECK_EQUAL(100, runQueue(queue));
+  CHECK_EQUAL(60, motor.currentPosition());
+  CHECK_EQUAL(0, queue.size());
+  for (unsigned int i = 1; i < 100; i++)
+  {
+    unsigned long expected = i < 50 ? 1000 : i < 70 ? 500 : 2000;
+    if (!CHECK_EQUAL(expected, times[i] - times[i - 1]))
+      printf("    step %u\n", i);
+  }
+}
+
+/*
+ * Two segments the same way, with an acceleration: the motor ramps up in
+ * the first, crosses into the second at full speed, and only ramps down
+ * at the end of it.
+ */
+static void testBlend(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperQueue queue(motor);
+
+  motor.setAcceleration(20000);
+  queue.push(400, 2000);
+  queue.push(400, 2000);
+
+  CHECK_EQUAL(800, runQueue(queue));
+  CHECK_EQUAL(800, motor.currentPosition());
+  // 2000 steps/s is 100 steps of ramp at 20000 steps/s/s:
+  for (unsigned int i = 200; i < 600; i++)
+    CHECK_EQUAL(500, times[i] - times[i - 1]);
+  CHECK(times[799] - times[798] > 2000);
+}
+
+/*
+ * A segment the other way starts from rest: the motor slows to a stop
+ * at the end of the first one, and ramps up again from the start.
+ */
+static void testReverse(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperQueue queue(motor);
+
+  motor.setAcceleration(20000);
+  queue.push(400, 2000);
+  queue.push(-400, 2000);
+
+  CHECK_EQUAL(800, runQueue(queue));
+  CHECK_EQUAL(0, motor.currentPosition());
+  CHECK(times[399] - times[398] > 2000);
+  CHECK(times[401] - times[400] > 2000);
+  CHECK_EQUAL(500, times[200] - times[199]);
+  CHECK_EQUAL(500, times[600] - times[599]);
+}
+
+/*
+ * A slower segment next: the first one slows down to the second one's
+ * speed by the junction, but not to a stop.
+ */
+static void testSlowDown(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperQueue queue(motor);
+
+  motor.setAcceleration(20000);
+  queue.push(400, 2000);
+  queue.push(200, 500);
+
+  CHECK_EQUAL(600, runQueue(queue));
+  CHECK_EQUAL(600, motor.currentPosition());
+  CHECK_EQUAL(500, times[250] - times[249]);
+  // within the few steps of ramp that 500 steps/s takes:
+  unsigned long junction = times[400] - times[399];
+  CHECK(junction > 1500 && junction < 3000);
+  for (unsigned int i = 410; i < 590; i++)
+    CHECK_EQUAL(2000, times[i] - times[i - 1]);
+}
+
+/*
+ * The queue holds STEPPER_QUEUE_SIZE segments; clear() drops those not
+ * started yet.
+ */
+static void testFullAndClear(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperQueue queue(motor);
+
+  for (uint8_t i = 0; i < STEPPER_QUEUE_SIZE; i++)
+    CHECK(queue.push(10, 1000));
+  CHECK(!queue.push(10, 1000));
+  CHECK_EQUAL(STEPPER_QUEUE_SIZE, queue.size());
+
+  queue.clear();
+  CHECK_EQUAL(0, queue.size());
+  mockClearTrace();
+  CHECK(!queue.run());
+  CHECK_EQUAL(0, mockTraceLength());
+}
+
+int main(void)
+{
+  printf("test_queue\n");
+  RUN_TEST(testBackToBack);
+  RUN_TEST(testBlend);
+  RUN_TEST(testReverse);
+  RUN_TEST(testSlowDown);
+  RUN_TEST(testFullAndClear);
+  return testResult();
+}
@@ -0,0 +1,262 @@
+/*
+ * test_ramp.cpp - Acceleration ramps of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Times the steps of run() with an acceleration set, from the pin trace,
+ * and checks them against the motion at a constant acceleration.
+ */
+
+#include <new>
+#include "Arduino.h"
+#include "Stepper.h"
+#include "test.h"
+
+#define MAX_STEPS 2100
+
+static unsigned long times[MAX_STEPS];
+
+/*
+ * Runs the motor with run() until it gets to its target, with time
+ * passing 1 us per call, and returns how many steps were taken, their
+ * times counted from the first one.
+ */
+static unsigned int runToTarget(Stepper &motor)
+{
+  mockSetMicros(1000000);
+  mockClearTrace();
+  while (motor.run() && micros() < 100000000UL)
+    mockAdvanceMicros(1);
+  unsigned int steps = writeTimes(times, MAX_STEPS);
+  for (unsigned int i = steps; i > 0; i--)
+    times[i - 1] -= times[0];
+  return steps;
+}
+
+/*
+ * Returns true if value is within percent of expected.
+ */
+static bool near(double expected, double value, double percent)
+{
+  return fabs(value - expected) <= fabs(expected) * percent / 100;
+}
+
+/*
+ * 2000 steps at up to 1000 steps/s, accelerating at 1000 steps/s/s: half
+ * a second's worth of steps, 500, to get to full speed, 1000 at full
+ * speed, and 500 to stop, 3 s in all.  The ramp starts at the speed of
+ * its first delay, v0, so step n of the ramp up comes t into the move,
+ * with n = v0 * t + a * t^2 / 2.
+ */
+static void testTrapezoid(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setMaxSpeed(1000);
+  motor.setAcceleration(1000);
+  motor.move(2000);
+  CHECK_EQUAL(2000, runToTarget(motor));
+  CHECK_EQUAL(2000, motor.currentPosition());
+  CHECK_EQUAL(0, motor.distanceToGo());
+
+  // the first delay, 0.676 * sqrt(2 / a):
+  CHECK(near(676000 * sqrt(2.0 / 1000), times[1], 1));
+  double v0 = 1000000.0 / times[1];
+
+  unsigned int cruise_start = 0, cruise_end = 0;
+  for (unsigned int i = 2; i < 2000; i++)
+  {
+    unsigned long interval = times[i] - times[i - 1];
+    unsigned long previous = times[i - 1] - times[i - 2];
+    if (interval == 1000 && cruise_start == 0)
+      cruise_start = i;
+    if (interval == 1000)
+      cruise_end = i;
+    // slower and slower on the ramps, never faster than the speed set:
+    CHECK(interval >= 1000);
+    if (cruise_start == 0)
+      CHECK(interval <= previous);
+    else if (i > cruise_end + 1)
+      CHECK(interval >= previous);
+  }
+  CHECK(near(500, cruise_start, 4));
+  CHECK(near(1500, cruise_end, 2));
+
+  for (unsigned int n = 50; n < 450; n += 10)
+  {
+    double t = (sqrt(v0 * v0 + 2.0 * 1000 * n) - v0) / 1000;
+    if (!CHECK(near(t * 1000000, times[n], 2)))
+      printf("    step %u at %lu us\n", n, times[n]);
+  }
+  // up to speed and back down, and 1000 steps at full speed in between;
+  // the ramp down ends at v0, the first delay short of a stop:
+  double ramp_time = (1000 - v0) / 1000;
+  double move_time = 2 * ramp_time * 1000000 + 1000000 - times[1];
+  if (!CHECK(near(move_time, times[1999], 1)))
+    printf("    move took %lu us, expected %.0f\n", times[1999], move_time);
+}
+
+/*
+ * A move too short to get to full speed ramps up half way and back
+ * down: 200 steps at 1000 steps/s/s peak at sqrt(2 * 1000 * 100), about
+ * 447 steps/s, 100 steps into the move.
+ */
+static void testTriangle(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setMaxSpeed(1000);
+  motor.setAcceleration(1000);
+  motor.move(-200);
+  CHECK_EQUAL(200, runToTarget(motor));
+  CHECK_EQUAL(-200, motor.currentPosition());
+
+  unsigned long fastest = times[1];
+  for (unsigned int i = 2; i < 200; i++)
+    fastest = min(fastest, times[i] - times[i - 1]);
+  CHECK(near(1000000 / sqrt(2.0 * 1000 * 100), fastest, 3));
+  // from the speed of the first delay, as in testTrapezoid():
+  double v0 = 1000000.0 / times[1];
+  double half_time = (sqrt(v0 * v0 + 2.0 * 1000 * 100) - v0) / 1000;
+  if (!CHECK(near(2 * half_time * 1000000 - times[1], times[199], 1)))
+    printf("    move took %lu us\n", times[199]);
+}
+
+/*
+ * A new target in the other direction part way through a move: the
+ * motor slows to a stop first, then ramps up the other way.
+ */
+static void testReverse(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setMaxSpeed(1000);
+  motor.setAcceleration(1000);
+  motor.move(1000);
+  mockSetMicros(1000000);
+  while (motor.currentPosition() < 500)
+  {
+    motor.run();
+    mockAdvanceMicros(1);
+  }
+  motor.moveTo(0);
+  long furthest = 0;
+  while (motor.run())
+  {
+    furthest = max(furthest, motor.currentPosition());
+    mockAdvanceMicros(1);
+  }
+  CHECK_EQUAL(0, motor.currentPosition());
+  // about the 500 steps it took to get up to speed, to stop:
+  CHECK(near(1000, furthest, 2));
+}
+
+/*
+ * setCurrentPosition() part way through a move stops the motor at once;
+ * the next move then starts from the bottom of the ramp again, its first
+ * step the first ramp delay after the last one, not at the speed the
+ * motor was stopped at.
+ */
+static void testSetPositionMidMove(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setMaxSpeed(2000);
+  motor.setAcceleration(1000);
+  motor.move(100000);
+  mockSetMicros(1000000);
+  while (motor.currentPosition() < 3000)
+  {
+    motor.run();
+    mockAdvanceMicros(1);
+  }
+  unsigned long last_step = micros() - 1;
+  motor.setCurrentPosition(0);
+  CHECK(!motor.run());
+
+  motor.move(10);
+  mockClearTrace();
+  while (motor.run())
+    mockAdvanceMicros(1);
+  CHECK_EQUAL(10, writeTimes(times, MAX_STEPS));
+  CHECK(near(676000 * sqrt(2.0 / 1000), times[0] - last_step, 1));
+}
+
+/*
+ * A Stepper that isn't in zeroed memory, e.g. a local one, with the
+ * acceleration set before the speed, starts its move right away.
+ */
+static void testUnzeroedMemory(void)
+{
+  static unsigned char memory[sizeof(Stepper)];
+  memset(memory, 0xA5, sizeof(memory));
+  Stepper *motor = new (memory) Stepper(200, 8, 9, 10, 11);
+
+  motor->setAcceleration(2000);
+  motor->setMaxSpeed(1000);
+  motor->move(100);
+  CHECK_EQUAL(100, runToTarget(*motor));
+  CHECK(times[99] < 1000000);
+  motor->~Stepper();
+}
+
+/*
+ * Only STEPPER_MAX_RAMPS motors get a ramp at once; one more runs at
+ * constant speed, until a ramp is given back by setAcceleration(0) or by
+ * a motor going out of scope.
+ */
+static void testRampTable(void)
+{
+  static unsigned char memory[STEPPER_MAX_RAMPS][sizeof(Stepper)];
+  Stepper *motors[STEPPER_MAX_RAMPS];
+  for (uint8_t i = 0; i < STEPPER_MAX_RAMPS; i++)
+  {
+    motors[i] = new (memory[i]) Stepper(200, 8, 9, 10, 11);
+    CHECK(motors[i]->setAcceleration(1000));
+  }
+
+  Stepper motor(200, 8, 9, 10, 11);
+  motor.setMaxSpeed(1000);
+  CHECK(!motor.setAcceleration(1000));
+  motor.move(10);
+  CHECK_EQUAL(10, runToTarget(motor));
+  CHECK_EQUAL(9000, times[9]);
+
+  CHECK(motors[0]->setAcceleration(0));
+  CHECK(motor.setAcceleration(1000));
+  CHECK(!motors[0]->setAcceleration(1000));
+  motors[1]->~Stepper();
+  CHECK(motors[0]->setAcceleration(1000));
+  motor.move(10);
+  CHECK_EQUAL(10, runToTarget(motor));
+  CHECK(times[9] > 9000 * 10);
+
+  motors[0]->~Stepper();
+  for (uint8_t i = 2; i < STEPPER_MAX_RAMPS; i++)
+    motors[i]->~Stepper();
+}
+
+int main(void)
+{
+  printf("test_ramp\n");
+  RUN_TEST(testTrapezoid);
+  RUN_TEST(testTriangle);
+  RUN_TEST(testReverse);
+  RUN_TEST(testSetPositionMidMove);
+  RUN_TEST(testUnzeroedMemory);
+  RUN_TEST(testRampTable);
+  return testResult();
+}
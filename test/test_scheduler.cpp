@@ -0,0 +1,194 @@
+/*
+ * test_scheduler.cpp - Deadline scheduling of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Runs motors at different speeds through StepperScheduler, and checks
+ * that each keeps its own step delay, that timeToNextStep() tells when
+ * the next step is due, and that late steps are caught up with.
+ */
+
+#include "Arduino.h"
+#include "Stepper.h"
+#include "StepperScheduler.h"
+#include "test.h"
+
+/*
+ * Collects the times of the writes to one pin since the trace was last
+ * cleared: one per step of a coil motor whose first pin it is.  Returns
+ * how many there are.
+ */
+static unsigned int pinTimes(uint8_t pin, unsigned long times[],
+                             unsigned int size)
+{
+  unsigned int count = 0;
+  for (unsigned int i = 0; i < mockTraceLength() && count < size; i++)
+  {
+    if (mockTrace()[i].pin == pin)
+      times[count++] = mockTrace()[i].time;
+  }
+  return count;
+}
+
+/*
+ * Two motors at different speeds each step at their own delay, the slow
+ * one unaffected by the fast one's steps between its own.
+ */
+static void testOwnSpeeds(void)
+{
+  Stepper slow(200, 8, 9, 10, 11);
+  Stepper fast(200, 4, 5, 6, 7);
+  StepperScheduler scheduler;
+  unsigned long times[200];
+
+  CHECK(scheduler.addStepper(slow));
+  CHECK(scheduler.addStepper(fast));
+  slow.setStepInterval(1000);
+  fast.setStepInterval(300);
+  slow.move(50);
+  fast.move(-150);
+
+  mockClearTrace();
+  while (scheduler.run())
+    mockAdvanceMicros(1);
+  CHECK_EQUAL(50, slow.currentPosition());
+  CHECK_EQUAL(-150, fast.currentPosition());
+
+  CHECK_EQUAL(50, pinTimes(8, times, 200));
+  for (unsigned int i = 1; i < 50; i++)
+    CHECK_EQUAL(1000, times[i] - times[i - 1]);
+  CHECK_EQUAL(150, pinTimes(4, times, 200));
+  for (unsigned int i = 1; i < 150; i++)
+    CHECK_EQUAL(300, times[i] - times[i - 1]);
+}
+
+/*
+ * timeToNextStep() counts down to the next step, and is 0 once it's due.
+ * An idle scheduler is looked at again after the idle interval.
+ */
+static void testTimeToNextStep(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperScheduler scheduler;
+
+  CHECK_EQUAL(STEPPER_SCHEDULER_IDLE_INTERVAL, scheduler.timeToNextStep());
+  scheduler.addStepper(motor);
+  motor.setStepInterval(1000);
+  motor.move(3);
+
+  mockSetMicros(5000);
+  mockClearTrace();
+  CHECK(scheduler.run());
+  CHECK_EQUAL(4, mockTraceLength());
+  CHECK_EQUAL(1000, scheduler.timeToNextStep());
+  mockAdvanceMicros(400);
+  CHECK_EQUAL(600, scheduler.timeToNextStep());
+  mockAdvanceMicros(700);
+  CHECK_EQUAL(0, scheduler.timeToNextStep());
+
+  // late, so the next step is due the rest of a delay later:
+  CHECK(scheduler.run());
+  CHECK_EQUAL(8, mockTraceLength());
+  CHECK_EQUAL(900, scheduler.timeToNextStep());
+}
+
+/*
+ * A step up to one delay late is made up for with the next one; after a
+ * longer stall, the steps go on from where they are without rushing.
+ */
+static void testCatchUp(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperScheduler scheduler;
+  unsigned long times[8];
+
+  scheduler.addStepper(motor);
+  motor.setStepInterval(1000);
+  motor.move(5);
+
+  mockSetMicros(0);
+  mockClearTrace();
+  scheduler.run();                // due at 0
+  mockSetMicros(1700);
+  scheduler.run();                // due at 1000
+  mockSetMicros(2000);
+  scheduler.run();                // due at 2000, and on time
+  mockSetMicros(9000);
+  scheduler.run();                // due at 3000, but too late to catch up
+  mockSetMicros(9999);
+  scheduler.run();
+  mockSetMicros(10000);
+  scheduler.run();
+  // the motor is seen to be done when it's next due:
+  mockSetMicros(11000);
+  CHECK(!scheduler.run());
+
+  CHECK_EQUAL(5, pinTimes(8, times, 8));
+  CHECK_EQUAL(0, times[0]);
+  CHECK_EQUAL(1700, times[1]);
+  CHECK_EQUAL(2000, times[2]);
+  CHECK_EQUAL(9000, times[3]);
+  CHECK_EQUAL(10000, times[4]);
+}
+
+/*
+ * A motor that was idle starts a new move within the idle interval.
+ */
+static void testIdleMotor(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperScheduler scheduler;
+
+  scheduler.addStepper(motor);
+  CHECK(!scheduler.run());
+  mockAdvanceMicros(300);
+  CHECK(!scheduler.run());
+
+  motor.setStepInterval(100);
+  motor.move(2);
+  mockClearTrace();
+  while (motor.distanceToGo() != 0 && micros() < 10000)
+  {
+    scheduler.run();
+    mockAdvanceMicros(1);
+  }
+  CHECK_EQUAL(2, motor.currentPosition());
+  CHECK(mockTrace()[0].time <= STEPPER_SCHEDULER_IDLE_INTERVAL);
+}
+
+/*
+ * A scheduler holds STEPPER_SCHEDULER_MAX_MOTORS motors, no more.
+ */
+static void testFull(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+  StepperScheduler scheduler;
+
+  for (uint8_t i = 0; i < STEPPER_SCHEDULER_MAX_MOTORS; i++)
+    CHECK(scheduler.addStepper(motor));
+  CHECK(!scheduler.addStepper(motor));
+}
+
+int main(void)
+{
+  printf("test_scheduler\n");
+  RUN_TEST(testOwnSpeeds);
+  RUN_TEST(testTimeToNextStep);
+  RUN_TEST(testCatchUp);
+  RUN_TEST(testIdleMotor);
+  RUN_TEST(testFull);
+  return testResult();
+}
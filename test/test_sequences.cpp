@@ -0,0 +1,267 @@
+/*
+ * test_sequences.cpp - Pin sequences of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Steps each kind of motor through its coil sequence, forward and back,
+ * and checks the pins against the tables at the top of Stepper.h, which
+ * are copied here as the golden traces.  Also checks release(), and the
+ * coil currents of microstepping.
+ */
+
+#include <math.h>
+#include "Arduino.h"
+#include "Stepper.h"
+#include "test.h"
+
+// the tables in Stepper.h, a row per step, C0 first:
+static const char *const golden_2wire[] = {
+  "01", "11", "10", "00"
+};
+static const char *const golden_4wire[] = {
+  "1010", "0110", "0101", "1001"
+};
+static const char *const golden_4wire_half[] = {
+  "1010", "0010", "0110", "0100", "0101", "0001", "1001", "1000"
+};
+static const char *const golden_4wire_wave[] = {
+  "0010", "0100", "0001", "1000"
+};
+static const char *const golden_5wire[] = {
+  "01101", "01001", "01011", "01010", "11010",
+  "10010", "10110", "10100", "10101", "00101"
+};
+
+static const uint8_t pins[5] = { 8, 9, 10, 11, 12 };
+
+/*
+ * Takes two turns of the sequence forward, one step at a time, then two
+ * back, checking that each step writes every motor pin once, in order,
+ * and leaves them at the next row of the table.
+ */
+static void checkSequence(Stepper &motor, uint8_t pin_count,
+                          const char *const golden[], int length)
+{
+  char levels[6];
+  int row = 0;
+
+  motor.setSpeed(60);
+  for (int i = 0; i < 4 * length; i++)
+  {
+    int direction = i < 2 * length ? 1 : -1;
+    mockClearTrace();
+    motor.step(direction);
+    row = (row + direction + length) % length;
+
+    CHECK_EQUAL(pin_count, mockTraceLength());
+    for (unsigned int write = 0; write < mockTraceLength(); write++)
+    {
+      CHECK_EQUAL(pins[write], mockTrace()[write].pin);
+      CHECK_EQUAL(mockTrace()[0].time, mockTrace()[write].time);
+    }
+    if (!CHECK(strcmp(golden[row], pinLevels(pins, pin_count, levels)) == 0))
+      printf("    step %d: pins %s, expected %s\n", i, levels, golden[row]);
+  }
+  CHECK_EQUAL(0, motor.currentPosition());
+}
+
+static void testTwoWire(void)
+{
+  Stepper motor(200, pins[0], pins[1]);
+  checkSequence(motor, 2, golden_2wire, 4);
+}
+
+static void testFourWire(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3]);
+  checkSequence(motor, 4, golden_4wire, 4);
+}
+
+static void testFourWireHalfStep(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3]);
+  motor.setStepMode(STEPPER_HALF_STEP);
+  checkSequence(motor, 4, golden_4wire_half, 8);
+}
+
+static void testFourWireWaveDrive(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3]);
+  motor.setStepMode(STEPPER_WAVE_DRIVE);
+  checkSequence(motor, 4, golden_4wire_wave, 4);
+}
+
+static void testFiveWire(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3], pins[4]);
+  checkSequence(motor, 5, golden_5wire, 10);
+}
+
+/*
+ * A driver's first step: the direction pin is set and left to settle,
+ * then the step pin pulses, with the default 2 us timings.
+ */
+static void testDriverPulse(void)
+{
+  static const MockPinWrite golden[] = {
+    { 0, 8, LOW }, { 0, 9, HIGH },   // direction set, forward
+    { 2, 8, HIGH }, { 2, 9, HIGH },  // after 2 us, the step pulse
+    { 4, 8, LOW }, { 4, 9, HIGH }    // 2 us wide
+  };
+
+  Stepper motor(200, STEPPER_DRIVER, pins[0], pins[1]);
+  motor.setStepInterval(0);
+  mockClearTrace();
+  mockSetMicros(0);
+  CHECK_EQUAL(0, motor.nextStep());   // already at the target
+  motor.move(1);
+  motor.nextStep();
+
+  CHECK_EQUAL(6, mockTraceLength());
+  for (unsigned int i = 0; i < 6 && i < mockTraceLength(); i++)
+  {
+    CHECK_EQUAL(golden[i].time, mockTrace()[i].time);
+    CHECK_EQUAL(golden[i].pin, mockTrace()[i].pin);
+    CHECK_EQUAL(golden[i].level, mockTrace()[i].level);
+  }
+}
+
+/*
+ * release() turns all coils off and keeps the position; the next step
+ * first turns them back on in the state they were left in, then steps
+ * one delay later.
+ */
+static void testRelease(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3]);
+  char levels[5];
+  unsigned long times[4];
+
+  motor.setSpeed(60);
+  motor.step(3);
+  motor.release();
+  CHECK(strcmp("0000", pinLevels(pins, 4, levels)) == 0);
+  CHECK_EQUAL(3, motor.currentPosition());
+
+  mockClearTrace();
+  motor.step(1);
+  CHECK_EQUAL(8, mockTraceLength());
+  CHECK_EQUAL(2, writeTimes(times, 4));
+  CHECK_EQUAL(5000, times[1] - times[0]);
+  for (unsigned int write = 0; write < 4 && write < mockTraceLength(); write++)
+    CHECK_EQUAL(mockTrace()[write].level, golden_4wire[3][write] == '1');
+  CHECK(strcmp(golden_4wire[0], pinLevels(pins, 4, levels)) == 0);
+  CHECK_EQUAL(4, motor.currentPosition());
+}
+
+/*
+ * With 2 wires every state energizes the coils, so release() leaves the
+ * pins alone.
+ */
+static void testReleaseTwoWire(void)
+{
+  Stepper motor(200, pins[0], pins[1]);
+
+  motor.setSpeed(60);
+  motor.step(1);
+  mockClearTrace();
+  motor.release();
+  CHECK_EQUAL(0, mockTraceLength());
+}
+
+/*
+ * 8 microsteps per full step: over a turn of the coil currents, coil A's
+ * duty cycle follows the cosine of the electrical angle and coil B's the
+ * sine, to within the rounding of the table, with the bridge inputs
+ * setting the signs.  On full steps the inputs are those of the full
+ * step sequence.
+ */
+static void testMicrostepping(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3]);
+  char levels[5];
+
+  motor.setMicrostepping(8, 5, 6);
+  motor.setSpeed(60);
+  for (int i = 1; i <= 64; i++)
+  {
+    int direction = i <= 32 ? 1 : -1;
+    motor.step(direction);
+    int microstep = (i <= 32 ? i : 64 - i) & 31;
+
+    // 45 degrees, the first full step, plus 360 / 32 degrees a microstep:
+    double angle = (16 + 4 * microstep) * 2 * M_PI / 128;
+    long duty_a = lround(255 * fabs(cos(angle)));
+    long duty_b = lround(255 * fabs(sin(angle)));
+    if (!CHECK(labs(mockAnalogValue(5) - duty_a) <= 1 &&
+               labs(mockAnalogValue(6) - duty_b) <= 1))
+      printf("    microstep %d: duty %d and %d, expected %ld and %ld\n",
+             microstep, mockAnalogValue(5), mockAnalogValue(6), duty_a, duty_b);
+
+    // a coil's inputs only matter while it carries current:
+    pinLevels(pins, 4, levels);
+    if (duty_a != 0)
+      CHECK(strncmp(cos(angle) > 0 ? "10" : "01", levels, 2) == 0);
+    if (duty_b != 0)
+      CHECK(strncmp(sin(angle) > 0 ? "10" : "01", levels + 2, 2) == 0);
+    if (microstep % 8 == 0)
+      CHECK(strcmp(golden_4wire[microstep / 8], levels) == 0);
+  }
+  CHECK_EQUAL(0, motor.currentPosition());
+}
+
+/*
+ * Released, a microstepping motor's enable pins are off too, and come
+ * back on at the microstep it was left on.
+ */
+static void testReleaseMicrostepping(void)
+{
+  Stepper motor(200, pins[0], pins[1], pins[2], pins[3]);
+
+  motor.setMicrostepping(8, 5, 6);
+  motor.setSpeed(60);
+  motor.step(3);
+  int duty_a = mockAnalogValue(5);
+  int duty_b = mockAnalogValue(6);
+  motor.release();
+  CHECK_EQUAL(0, mockAnalogValue(5));
+  CHECK_EQUAL(0, mockAnalogValue(6));
+
+  // the coils come on again when the step is due, and the step follows
+  // one delay later:
+  motor.move(1);
+  mockAdvanceMicros(5000);
+  motor.run();
+  CHECK_EQUAL(duty_a, mockAnalogValue(5));
+  CHECK_EQUAL(duty_b, mockAnalogValue(6));
+  CHECK_EQUAL(3, motor.currentPosition());
+}
+
+int main(void)
+{
+  printf("test_sequences\n");
+  RUN_TEST(testTwoWire);
+  RUN_TEST(testFourWire);
+  RUN_TEST(testFourWireHalfStep);
+  RUN_TEST(testFourWireWaveDrive);
+  RUN_TEST(testFiveWire);
+  RUN_TEST(testDriverPulse);
+  RUN_TEST(testRelease);
+  RUN_TEST(testReleaseTwoWire);
+  RUN_TEST(testMicrostepping);
+  RUN_TEST(testReleaseMicrostepping);
+  return testResult();
+}
@@ -0,0 +1,246 @@
+/*
+ * test_timing.cpp - Step timing of the Stepper library, on a PC
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ *
+ * Times the steps of step() and run() at constant speeds, from the pin
+ * trace, including the fractions of a us of the step delay, and when an
+ * idle motor is released.
+ */
+
+#include "Arduino.h"
+#include "Stepper.h"
+#include "test.h"
+
+#define MAX_STEPS 1100
+
+static unsigned long times[MAX_STEPS];
+
+/*
+ * Runs the motor with run() until it gets to its target, with time
+ * passing 1 us per call, and returns how many steps were taken.
+ */
+static unsigned int runToTarget(Stepper &motor)
+{
+  mockClearTrace();
+  while (motor.run())
+    mockAdvanceMicros(1);
+  return writeTimes(times, MAX_STEPS);
+}
+
+/*
+ * Checks that the delays between the steps add up to whole us plus the
+ * given fraction, in 1/256 us, for every 256 steps, and that no delay is
+ * more than 1 us off the others.
+ */
+static void checkFractionalDelays(unsigned long delay, uint8_t fraction)
+{
+  unsigned long sum = 0;
+  for (unsigned int i = 1; i <= 256; i++)
+  {
+    unsigned long interval = times[i] - times[i - 1];
+    CHECK(interval == delay || interval == delay + 1);
+    sum += interval;
+  }
+  CHECK_EQUAL(256 * delay + fraction, sum);
+}
+
+/*
+ * step() at 60 RPM on a 200 step motor takes a step every 5000 us, the
+ * first one right away.
+ */
+static void testStepTiming(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setSpeed(60);
+  mockSetMicros(1000000);
+  mockClearTrace();
+  motor.step(20);
+
+  CHECK_EQUAL(20, writeTimes(times, MAX_STEPS));
+  CHECK_EQUAL(1000000, times[0]);
+  for (unsigned int i = 1; i < 20; i++)
+    CHECK_EQUAL(5000, times[i] - times[i - 1]);
+  CHECK_EQUAL(20, motor.currentPosition());
+}
+
+/*
+ * step() with a negative number of steps goes back at the same rate.
+ */
+static void testStepReverse(void)
+{
+  Stepper motor(200, 8, 9);
+
+  motor.setStepInterval(1500);
+  mockSetMicros(1000000);
+  mockClearTrace();
+  motor.step(-10);
+
+  CHECK_EQUAL(10, writeTimes(times, MAX_STEPS));
+  for (unsigned int i = 1; i < 10; i++)
+    CHECK_EQUAL(1500, times[i] - times[i - 1]);
+  CHECK_EQUAL(-10, motor.currentPosition());
+}
+
+/*
+ * 3000 steps per second is 333 + 85/256 us per step: the extra 1 us
+ * comes every third step or so, so that 256 steps take 85 us more than
+ * 256 * 333 us.
+ */
+static void testFractionalDelay(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setMaxSpeed(3000);
+  mockSetMicros(1000000);
+  motor.move(257);
+  CHECK_EQUAL(257, runToTarget(motor));
+  checkFractionalDelays(333, 85);
+}
+
+/*
+ * setSpeed() keeps the fraction too: on the 2048 step 28BYJ-48, 10 RPM
+ * is 2929.6875 us per step, 2929 us and 176/256.
+ */
+static void testSpeedFraction(void)
+{
+  Stepper motor(2048, 8, 9, 10, 11);
+
+  motor.setSpeed(10);
+  mockSetMicros(1000000);
+  motor.move(257);
+  CHECK_EQUAL(257, runToTarget(motor));
+  checkFractionalDelays(2929, 176);
+}
+
+/*
+ * setStepInterval() sets whole us, with no fraction.
+ */
+static void testStepInterval(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setStepInterval(250);
+  mockSetMicros(1000000);
+  motor.move(257);
+  CHECK_EQUAL(257, runToTarget(motor));
+  checkFractionalDelays(250, 0);
+}
+
+/*
+ * runSpeed() steps at the speed set, with the fraction, and stops when
+ * the speed is set to 0.
+ */
+static void testRunSpeed(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setSpeedStepsPerSecond(-3000);
+  mockSetMicros(1000000);
+  mockClearTrace();
+  unsigned int steps = 0;
+  while (steps < 257)
+  {
+    if (motor.runSpeed())
+      steps++;
+    mockAdvanceMicros(1);
+  }
+  CHECK_EQUAL(257, writeTimes(times, MAX_STEPS));
+  checkFractionalDelays(333, 85);
+  CHECK_EQUAL(-257, motor.currentPosition());
+
+  motor.setSpeedStepsPerSecond(0);
+  mockAdvanceMicros(10000);
+  CHECK(!motor.runSpeed());
+}
+
+/*
+ * At fixed rate, a step taken late is timed from when it was due, so the
+ * next one makes up for it; a stall of more than a step starts again.
+ */
+static void testFixedRate(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setStepInterval(1000);
+  motor.setFixedRate(true);
+  mockSetMicros(1000000);
+  motor.move(4);
+  mockClearTrace();
+  motor.run();                     // the first step, now
+  mockAdvanceMicros(1300);         // 300 us late
+  motor.run();
+  mockAdvanceMicros(700);          // due 1000 us after the last was due
+  motor.run();
+  mockAdvanceMicros(5000);         // stalled for several steps
+  motor.run();
+
+  CHECK_EQUAL(4, writeTimes(times, MAX_STEPS));
+  CHECK_EQUAL(1300, times[1] - times[0]);
+  CHECK_EQUAL(700, times[2] - times[1]);
+  CHECK_EQUAL(5000, times[3] - times[2]);
+}
+
+/*
+ * With an auto-release time, run() turns the coils off once the motor has
+ * been idle that long since its last step, and not before.  The next move
+ * turns them on again on its first due run(), and steps a delay later.
+ */
+static void testAutoRelease(void)
+{
+  Stepper motor(200, 8, 9, 10, 11);
+
+  motor.setStepInterval(1000);
+  motor.setAutoRelease(10);
+  mockSetMicros(1000000);
+  motor.move(3);
+  runToTarget(motor);
+  unsigned long last_step = mockTrace()[mockTraceLength() - 1].time;
+
+  mockClearTrace();
+  while (micros() - last_step < 9999)
+  {
+    motor.run();
+    mockAdvanceMicros(1);
+  }
+  motor.run();
+  CHECK_EQUAL(0, mockTraceLength());
+  mockAdvanceMicros(1);
+  motor.run();
+  CHECK_EQUAL(4, mockTraceLength());
+  for (unsigned int i = 0; i < mockTraceLength(); i++)
+    CHECK_EQUAL(LOW, mockTrace()[i].level);
+
+  motor.move(1);
+  CHECK_EQUAL(2, runToTarget(motor));
+  CHECK_EQUAL(1000, times[1] - times[0]);
+  CHECK_EQUAL(4, motor.currentPosition());
+}
+
+int main(void)
+{
+  printf("test_timing\n");
+  RUN_TEST(testStepTiming);
+  RUN_TEST(testStepReverse);
+  RUN_TEST(testFractionalDelay);
+  RUN_TEST(testSpeedFraction);
+  RUN_TEST(testStepInterval);
+  RUN_TEST(testRunSpeed);
+  RUN_TEST(testFixedRate);
+  RUN_TEST(testAutoRelease);
+  return testResult();
+}